@@ -0,0 +1,1453 @@
+/*
+ * bench.cpp
+ * Throughput benchmarks for the structures in bstbt.cpp.
+ *
+ * How to Compile and Run:
+ *		g++ bench.cpp -std=c++11 -O2 -pthread -o bench
+ *		./bench [elements]
+ *		./bench --suite [--sizes 1K,1M,...] [--workloads uniform,...]
+ *		        [--structures BST,...] [--csv file] [--json file]
+ *
+ * The element count defaults to 10,000,000. --suite runs every structure in
+ * bstbt.cpp and rbtree.cpp, and the std containers they compete with, over
+ * each workload and size, reporting throughput and p50/p99/p999 latency.
+ * Operations it does not run are still listed, as skipped rows with the
+ * reason, in the table and in the CSV/JSON exports.
+ *
+ * The suite's default sizes stop at 1M. Every case keeps its keys twice,
+ * in insertion and in shuffled order, next to the structure under test, so
+ * 100M keys take several GB per int structure and about 20 GB for the
+ * string workloads, and the full grid runs for hours. Ask for it with
+ * --sizes 10M,100M on a machine that has the memory.
+ */
+
+#define TREES_NO_MAIN
+#include "bstbt.cpp"
+#include "rbtree.cpp"
+
+#include <chrono>
+#include <random>
+#include <numeric>
+#include <set>
+#include <cstring>
+#include <iomanip>
+
+// The heap as it was before BasicHeap: one class for both orders, with the
+// order checked on every comparison. Kept here as the baseline.
+class RuntimeFlagHeap
+{
+private:
+    vector<int> data;
+    bool isMinHeap;
+
+    bool compare(int a, int b)
+    {
+        if (isMinHeap)
+            return a < b;
+        else
+            return a > b;
+    }
+
+    void heapifyUp(int index)
+    {
+        while (index > 0)
+        {
+            int parent = (index - 1) / 2;
+            if (compare(data[index], data[parent]))
+            {
+                swap(data[index], data[parent]);
+                index = parent;
+            }
+            else
+            {
+                break;
+            }
+        }
+    }
+
+    void heapifyDown(int index)
+    {
+        int size = data.size();
+        while (true)
+        {
+            int left = 2 * index + 1;
+            int right = 2 * index + 2;
+            int selected = index;
+            if (left < size && compare(data[left], data[selected]))
+                selected = left;
+            if (right < size && compare(data[right], data[selected]))
+                selected = right;
+            if (selected != index)
+            {
+                swap(data[index], data[selected]);
+                index = selected;
+            }
+            else
+            {
+                break;
+            }
+        }
+    }
+
+public:
+    RuntimeFlagHeap(bool isMin = true) : isMinHeap(isMin) {}
+
+    void insert(int value)
+    {
+        data.push_back(value);
+        heapifyUp(data.size() - 1);
+    }
+
+    int getRoot()
+    {
+        return data[0];
+    }
+
+    void removeRoot()
+    {
+        data[0] = data.back();
+        data.pop_back();
+        if (!data.empty())
+            heapifyDown(0);
+    }
+};
+
+// A binary heap that sifts top-down, comparing the moved element with the best
+// child at every level. Baseline for BasicHeap's bottom-up removeRoot.
+template <typename T, typename Compare>
+class TopDownHeap
+{
+private:
+    vector<T> data;
+    Compare compare;
+
+public:
+    TopDownHeap(const Compare& compare) : compare(compare) {}
+
+    void insert(const T& value)
+    {
+        data.push_back(value);
+        size_t index = data.size() - 1;
+        while (index > 0 && compare(data[index], data[(index - 1) / 2]))
+        {
+            swap(data[index], data[(index - 1) / 2]);
+            index = (index - 1) / 2;
+        }
+    }
+
+    const T& getRoot() const
+    {
+        return data[0];
+    }
+
+    void removeRoot()
+    {
+        data[0] = move(data.back());
+        data.pop_back();
+        size_t size = data.size();
+        size_t index = 0;
+        while (2 * index + 1 < size)
+        {
+            size_t selected = 2 * index + 1;
+            if (selected + 1 < size && compare(data[selected + 1], data[selected]))
+                selected++;
+            if (!compare(data[selected], data[index]))
+                break;
+            swap(data[index], data[selected]);
+            index = selected;
+        }
+    }
+};
+
+// Counts every call so sift strategies can be compared by work done.
+template <typename T>
+struct CountingLess
+{
+    long long* calls;
+    CountingLess(long long* calls = nullptr) : calls(calls) {}
+    bool operator()(const T& a, const T& b) const
+    {
+        ++*calls;
+        return a < b;
+    }
+};
+
+typedef chrono::steady_clock Clock;
+
+double secondsSince(Clock::time_point start)
+{
+    return chrono::duration<double>(Clock::now() - start).count();
+}
+
+void report(const string& name, size_t operations, double pushSeconds, double popSeconds, long long checksum)
+{
+    cout << name << ": push " << operations / pushSeconds / 1e6 << " M/s, pop "
+         << operations / popSeconds / 1e6 << " M/s (checksum " << checksum << ")\n";
+}
+
+template <typename HeapType>
+void benchHeap(const string& name, HeapType& heap, const vector<int>& values)
+{
+    Clock::time_point start = Clock::now();
+    for (size_t i = 0; i < values.size(); i++)
+    {
+        heap.insert(values[i]);
+    }
+    double pushSeconds = secondsSince(start);
+    long long checksum = 0;
+    start = Clock::now();
+    for (size_t i = 0; i < values.size(); i++)
+    {
+        checksum += heap.getRoot();
+        heap.removeRoot();
+    }
+    double popSeconds = secondsSince(start);
+    report(name, values.size(), pushSeconds, popSeconds, checksum);
+}
+
+template <typename HeapType, typename T>
+void benchPops(const string& name, HeapType& heap, const vector<T>& values, long long& calls)
+{
+    for (size_t i = 0; i < values.size(); i++)
+    {
+        heap.insert(values[i]);
+    }
+    calls = 0;
+    Clock::time_point start = Clock::now();
+    for (size_t i = 0; i < values.size(); i++)
+    {
+        heap.removeRoot();
+    }
+    double seconds = secondsSince(start);
+    cout << name << ": pop " << values.size() / seconds / 1e6 << " M/s, "
+         << double(calls) / values.size() << " comparisons per pop\n";
+}
+
+template <typename T>
+void benchSiftStrategies(const string& label, const vector<T>& values)
+{
+    cout << "\nremoveRoot sift on " << values.size() << " " << label << "\n";
+    long long calls = 0;
+    {
+        TopDownHeap<T, CountingLess<T>> heap((CountingLess<T>(&calls)));
+        benchPops("top-down", heap, values, calls);
+    }
+    {
+        BasicHeap<T, CountingLess<T>> heap((CountingLess<T>(&calls)));
+        benchPops("bottom-up", heap, values, calls);
+    }
+}
+
+void benchBulkLoad(const vector<int>& values, size_t existing)
+{
+    cout << "\nBulk loading " << values.size() - existing << " ints into a heap of " << existing << "\n";
+    {
+        BasicHeap<int, less<int>> heap;
+        heap.insertBatch(values.begin(), values.begin() + existing);
+        Clock::time_point start = Clock::now();
+        for (size_t i = existing; i < values.size(); i++)
+        {
+            heap.insert(values[i]);
+        }
+        cout << "insert loop: " << secondsSince(start) << " s\n";
+    }
+    {
+        BasicHeap<int, less<int>> heap;
+        heap.insertBatch(values.begin(), values.begin() + existing);
+        Clock::time_point start = Clock::now();
+        heap.insertBatch(values.begin() + existing, values.end());
+        cout << "insertBatch: " << secondsSince(start) << " s\n";
+    }
+    cout << "Building a heap of " << values.size() << " ints from scratch\n";
+    {
+        Clock::time_point start = Clock::now();
+        BasicHeap<int, less<int>> heap;
+        for (size_t i = 0; i < values.size(); i++)
+        {
+            heap.insert(values[i]);
+        }
+        cout << "insert loop: " << secondsSince(start) << " s\n";
+    }
+    {
+        vector<int> copy(values);
+        Clock::time_point start = Clock::now();
+        BasicHeap<int, less<int>> heap(move(copy));
+        cout << "vector&& constructor: " << secondsSince(start) << " s\n";
+    }
+}
+
+// Shortest-path style workload: `items` keys that only ever decrease, with a
+// pop after every ten updates. Without handles the usual workaround is to push
+// a duplicate and skip stale entries as they surface. Both sides order by
+// (key, item) so they pop the same sequence.
+void benchPriorityUpdates(const vector<int>& values, size_t items)
+{
+    cout << "\n" << values.size() << " decrease-key updates over " << items << " keys\n";
+    {
+        Clock::time_point start = Clock::now();
+        IndexedHeap<pair<int, size_t>> heap;
+        vector<size_t> handles(items);
+        for (size_t i = 0; i < items; i++)
+        {
+            handles[i] = heap.insert(make_pair(values[i] & 0x3fffffff, i));
+        }
+        long long checksum = 0;
+        for (size_t i = 0; i < values.size(); i++)
+        {
+            size_t item = size_t(values[i]) % items;
+            if (heap.contains(handles[item]))
+            {
+                heap.update(handles[item], make_pair(heap.get(handles[item]).first - (values[i] & 0xffff), item));
+            }
+            if (i % 10 == 9 && !heap.isEmpty())
+            {
+                checksum += heap.getRoot().first;
+                heap.removeRoot();
+            }
+        }
+        while (!heap.isEmpty())
+        {
+            checksum += heap.getRoot().first;
+            heap.removeRoot();
+        }
+        cout << "IndexedHeap update: " << secondsSince(start) << " s (checksum " << checksum << ")\n";
+    }
+    {
+        Clock::time_point start = Clock::now();
+        BasicHeap<pair<int, size_t>, less<pair<int, size_t>>> heap;
+        vector<int> current(items);
+        vector<bool> done(items);
+        for (size_t i = 0; i < items; i++)
+        {
+            current[i] = values[i] & 0x3fffffff;
+            heap.insert(make_pair(current[i], i));
+        }
+        long long checksum = 0;
+        size_t remaining = items;
+        for (size_t i = 0; i < values.size() || remaining > 0; i++)
+        {
+            if (i < values.size())
+            {
+                size_t item = size_t(values[i]) % items;
+                if (!done[item])
+                {
+                    current[item] -= values[i] & 0xffff;
+                    heap.insert(make_pair(current[item], item));
+                }
+                if (i % 10 != 9)
+                {
+                    continue;
+                }
+            }
+            while (!heap.isEmpty() && (done[heap.getRoot().second] || heap.getRoot().first != current[heap.getRoot().second]))
+            {
+                heap.removeRoot();
+            }
+            if (!heap.isEmpty())
+            {
+                checksum += heap.getRoot().first;
+                done[heap.getRoot().second] = true;
+                heap.removeRoot();
+                remaining--;
+            }
+        }
+        cout << "duplicate push: " << secondsSince(start) << " s (checksum " << checksum << ")\n";
+    }
+}
+
+// Workers each fill a small heap, then the heaps are merged pairwise in
+// rounds until one is left. The binary heap has to copy the smaller side in
+// at every merge, which the pairing heap replaces with one link.
+void benchMerges(const vector<int>& values, size_t perHeap)
+{
+    size_t heapCount = values.size() / perHeap;
+    size_t pops = values.size() / 10;
+    cout << "\nMerging " << heapCount << " heaps of " << perHeap << " ints, then " << pops << " pops\n";
+    {
+        Clock::time_point start = Clock::now();
+        vector<BasicHeap<int, less<int>>> heaps(heapCount);
+        for (size_t i = 0; i < heapCount * perHeap; i++)
+        {
+            heaps[i / perHeap].insert(values[i]);
+        }
+        double buildSeconds = secondsSince(start);
+        start = Clock::now();
+        for (size_t step = 1; step < heapCount; step *= 2)
+        {
+            for (size_t i = 0; i + step < heapCount; i += 2 * step)
+            {
+                BasicHeap<int, less<int>>& other = heaps[i + step];
+                heaps[i].insertBatch(other.elements(), other.elements() + other.size());
+                other.release();
+            }
+        }
+        double mergeSeconds = secondsSince(start);
+        start = Clock::now();
+        long long checksum = 0;
+        for (size_t i = 0; i < pops; i++)
+        {
+            checksum += heaps[0].getRoot();
+            heaps[0].removeRoot();
+        }
+        cout << "BasicHeap: build " << buildSeconds << " s, merge " << mergeSeconds << " s, pops " << secondsSince(start)
+             << " s (checksum " << checksum << ")\n";
+    }
+    {
+        Clock::time_point start = Clock::now();
+        vector<PairingHeap<int>> heaps(heapCount);
+        for (size_t i = 0; i < heapCount * perHeap; i++)
+        {
+            heaps[i / perHeap].insert(values[i]);
+        }
+        double buildSeconds = secondsSince(start);
+        start = Clock::now();
+        for (size_t step = 1; step < heapCount; step *= 2)
+        {
+            for (size_t i = 0; i + step < heapCount; i += 2 * step)
+            {
+                heaps[i].merge(heaps[i + step]);
+            }
+        }
+        double mergeSeconds = secondsSince(start);
+        start = Clock::now();
+        long long checksum = 0;
+        for (size_t i = 0; i < pops; i++)
+        {
+            checksum += heaps[0].getRoot();
+            heaps[0].removeRoot();
+        }
+        cout << "PairingHeap: build " << buildSeconds << " s, merge " << mergeSeconds << " s, pops " << secondsSince(start)
+             << " s (checksum " << checksum << ")\n";
+    }
+}
+
+// Every thread alternates push and pop on a prefilled queue. The baseline is
+// the single mutex around one heap that producers and consumers share today.
+template <typename Queue>
+double runMixedThreads(Queue& queue, const vector<int>& values, size_t threadCount, size_t opsPerThread)
+{
+    vector<thread> workers;
+    Clock::time_point start = Clock::now();
+    for (size_t t = 0; t < threadCount; t++)
+    {
+        workers.push_back(thread([&queue, &values, t, threadCount, opsPerThread]() {
+            int popped;
+            for (size_t i = t; i < opsPerThread * threadCount; i += threadCount)
+            {
+                queue.push(values[i % values.size()]);
+                queue.tryPop(popped);
+            }
+        }));
+    }
+    for (size_t t = 0; t < workers.size(); t++)
+    {
+        workers[t].join();
+    }
+    return secondsSince(start);
+}
+
+struct LockedHeap
+{
+    mutex lock;
+    BasicHeap<int, less<int>> heap;
+
+    void push(int value)
+    {
+        lock_guard<mutex> guard(lock);
+        heap.insert(value);
+    }
+
+    bool tryPop(int& out)
+    {
+        lock_guard<mutex> guard(lock);
+        if (heap.isEmpty())
+            return false;
+        out = heap.getRoot();
+        heap.removeRoot();
+        return true;
+    }
+};
+
+// Rank error of a pop is how many queued values would have come out before
+// it in a strict queue, counted with a Fenwick tree over the value ranks.
+void measureRankError(size_t count, size_t lanes)
+{
+    vector<int> ranks(count);
+    for (size_t i = 0; i < count; i++)
+    {
+        ranks[i] = i;
+    }
+    shuffle(ranks.begin(), ranks.end(), mt19937(7));
+    MultiQueue<int> queue(lanes);
+    vector<int> present(count + 1);
+    for (size_t i = 0; i < count; i++)
+    {
+        queue.push(ranks[i]);
+        for (size_t j = ranks[i] + 1; j <= count; j += j & (0 - j))
+            present[j]++;
+    }
+    double totalError = 0;
+    long long maxError = 0;
+    int value;
+    while (queue.tryPop(value))
+    {
+        long long error = 0;
+        for (size_t j = value; j > 0; j -= j & (0 - j))
+            error += present[j];
+        for (size_t j = value + 1; j <= count; j += j & (0 - j))
+            present[j]--;
+        totalError += error;
+        maxError = max(maxError, error);
+    }
+    cout << lanes << " lanes: mean rank error " << totalError / count << ", max " << maxError << "\n";
+}
+
+void benchMultiQueue(const vector<int>& values)
+{
+    size_t ops = values.size() / 4;
+    cout << "\nConcurrent push+pop pairs, " << ops << " per run (hardware threads: "
+         << thread::hardware_concurrency() << ")\n";
+    const size_t threadCounts[] = { 1, 2, 4, 8 };
+    for (size_t i = 0; i < 4; i++)
+    {
+        size_t threads = threadCounts[i];
+        LockedHeap locked;
+        MultiQueue<int> multi(2 * threads);
+        for (size_t j = 0; j < values.size() / 10; j++)
+        {
+            locked.push(values[j]);
+            multi.push(values[j]);
+        }
+        double lockedSeconds = runMixedThreads(locked, values, threads, ops / threads);
+        double multiSeconds = runMixedThreads(multi, values, threads, ops / threads);
+        MultiQueueStats stats = multi.stats();
+        cout << threads << " threads: single mutex " << ops / lockedSeconds / 1e6 << " M/s, MultiQueue "
+             << ops / multiSeconds / 1e6 << " M/s (" << double(stats.lockRetries) / stats.pops
+             << " lock retries per pop)\n";
+    }
+    cout << "Rank error over " << values.size() / 10 << " pops\n";
+    measureRankError(values.size() / 10, 2);
+    measureRankError(values.size() / 10, 8);
+    measureRankError(values.size() / 10, 32);
+}
+
+// Pushes and pops everything through an ExternalHeap that may only keep a
+// 64th of the values in memory, against the all-in-memory BasicHeap.
+void benchExternalHeap(const vector<int>& values)
+{
+    size_t limit = max<size_t>(values.size() / 64, 1);
+    cout << "\nExternal heap, " << values.size() << " ints with " << limit << " in memory\n";
+    {
+        BasicHeap<int, less<int>> heap;
+        benchHeap("in-memory BasicHeap", heap, values);
+    }
+    {
+        ExternalHeap<int> heap(limit);
+        benchHeap("ExternalHeap", heap, values);
+        cout << "spilled " << heap.spilledCount() << " values" << (heap.failed() ? ", I/O failed" : "") << "\n";
+    }
+}
+
+// Keeping the k largest of a stream: push everything and pop k, against the
+// bounded heap fed one value at a time and in chunks through the fast reject.
+void benchTopK(const vector<int>& values, size_t k)
+{
+    cout << "\nTop " << k << " of " << values.size() << " ints\n";
+    long long checksum = 0;
+    {
+        Clock::time_point start = Clock::now();
+        BasicHeap<int, greater<int>> heap;
+        for (size_t i = 0; i < values.size(); i++)
+        {
+            heap.insert(values[i]);
+        }
+        for (size_t i = 0; i < k && !heap.isEmpty(); i++)
+        {
+            checksum += heap.getRoot();
+            heap.removeRoot();
+        }
+        cout << "push all, pop k: " << secondsSince(start) << " s (checksum " << checksum << ")\n";
+    }
+    {
+        Clock::time_point start = Clock::now();
+        TopK<int> top(k);
+        for (size_t i = 0; i < values.size(); i++)
+        {
+            top.offer(values[i]);
+        }
+        vector<int> best = top.sorted();
+        checksum = accumulate(best.begin(), best.end(), 0LL);
+        cout << "TopK offer: " << secondsSince(start) << " s (checksum " << checksum << ")\n";
+    }
+    {
+        Clock::time_point start = Clock::now();
+        TopK<int> top(k);
+        for (size_t i = 0; i < values.size(); i += 1 << 18)
+        {
+            top.offerBatch(values.data() + i, min<size_t>(1 << 18, values.size() - i));
+        }
+        vector<int> best = top.sorted();
+        checksum = accumulate(best.begin(), best.end(), 0LL);
+        cout << "TopK offerBatch: " << secondsSince(start) << " s (checksum " << checksum << ")\n";
+    }
+}
+
+// Random lookups, about half of them hits, against the pointer tree, the
+// frozen Eytzinger snapshot and a binary search over a sorted array.
+void benchFrozenLookups(const vector<int>& values)
+{
+    cout << "\nBST lookups over " << values.size() << " random keys\n";
+    BST bst(false);
+    streambuf* saved = cout.rdbuf(nullptr);
+    for (size_t i = 0; i < values.size(); i++)
+    {
+        bst.insert(values[i] & ~1);
+    }
+    cout.rdbuf(saved);
+    vector<int> sorted(values);
+    for (size_t i = 0; i < sorted.size(); i++)
+    {
+        sorted[i] &= ~1;
+    }
+    sort(sorted.begin(), sorted.end());
+    mt19937 rng(99);
+    vector<int> queries(values.size());
+    for (size_t i = 0; i < queries.size(); i++)
+    {
+        queries[i] = (values[rng() % values.size()] & ~1) | (rng() & 1);
+    }
+    size_t hits = 0;
+    Clock::time_point start = Clock::now();
+    for (size_t i = 0; i < queries.size(); i++)
+    {
+        hits += bst.contains(queries[i]);
+    }
+    double seconds = secondsSince(start);
+    cout << "pointer tree: " << queries.size() / seconds / 1e6 << " M lookups/s (" << hits << " hits)\n";
+    start = Clock::now();
+    bst.freeze();
+    cout << "freeze: " << secondsSince(start) << " s\n";
+    hits = 0;
+    start = Clock::now();
+    for (size_t i = 0; i < queries.size(); i++)
+    {
+        hits += bst.contains(queries[i]);
+    }
+    seconds = secondsSince(start);
+    cout << "frozen Eytzinger: " << queries.size() / seconds / 1e6 << " M lookups/s (" << hits << " hits)\n";
+    hits = 0;
+    start = Clock::now();
+    for (size_t i = 0; i < queries.size(); i++)
+    {
+        hits += binary_search(sorted.begin(), sorted.end(), queries[i]);
+    }
+    seconds = secondsSince(start);
+    cout << "sorted array binary_search: " << queries.size() / seconds / 1e6 << " M lookups/s (" << hits << " hits)\n";
+}
+
+void benchBuildFrom(const vector<int>& values)
+{
+    cout << "\nBST build from " << values.size() << " unsorted keys\n";
+    streambuf* saved = cout.rdbuf(nullptr);
+    BST inserted(false);
+    Clock::time_point start = Clock::now();
+    for (size_t i = 0; i < values.size(); i++)
+    {
+        inserted.insert(values[i]);
+    }
+    double insertSeconds = secondsSince(start);
+    BST built(false);
+    start = Clock::now();
+    built.buildFrom(values);
+    double buildSeconds = secondsSince(start);
+    int insertedMax = inserted.levelOfMax();
+    int builtMax = built.levelOfMax();
+    cout.rdbuf(saved);
+    cout << "insert loop: " << insertSeconds << " s (" << inserted.size() << " keys, maximum at level "
+         << insertedMax << ")\n";
+    cout << "buildFrom: " << buildSeconds << " s (" << built.size() << " keys, maximum at level "
+         << builtMax << ")\n";
+}
+
+// A level-order walk of an insert-built tree before and after compact()
+// repacks its nodes in level order, then the cost of dropping the tree.
+void benchNodePacking(const vector<int>& values)
+{
+    cout << "\nBST node packing over " << values.size() << " keys\n";
+    BST* bst = new BST(false);
+    streambuf* saved = cout.rdbuf(nullptr);
+    for (size_t i = 0; i < values.size(); i++)
+    {
+        bst->insert(values[i]);
+    }
+    Clock::time_point start = Clock::now();
+    bst->levelOrderTraversal();
+    double scatteredSeconds = secondsSince(start);
+    start = Clock::now();
+    bst->compact();
+    double compactSeconds = secondsSince(start);
+    start = Clock::now();
+    bst->levelOrderTraversal();
+    double packedSeconds = secondsSince(start);
+    start = Clock::now();
+    delete bst;
+    double teardownSeconds = secondsSince(start);
+    cout.rdbuf(saved);
+    cout << "level-order walk, insertion layout: " << scatteredSeconds << " s\n";
+    cout << "compact: " << compactSeconds << " s\n";
+    cout << "level-order walk, packed layout: " << packedSeconds << " s\n";
+    cout << "teardown: " << teardownSeconds << " s\n";
+}
+
+// The baseline the ingest threads use today: one lock around a BST.
+struct LockedBST
+{
+    mutex lock;
+    BST tree;
+    LockedBST() : tree(false) {}
+
+    bool insert(int value)
+    {
+        lock_guard<mutex> guard(lock);
+        size_t before = tree.size();
+        tree.insert(value);
+        return tree.size() != before;
+    }
+
+    bool remove(int value)
+    {
+        lock_guard<mutex> guard(lock);
+        size_t before = tree.size();
+        tree.remove(value);
+        return tree.size() != before;
+    }
+
+    bool contains(int value)
+    {
+        lock_guard<mutex> guard(lock);
+        return tree.contains(value);
+    }
+};
+
+// Each thread draws keys from [0, keyRange) and does `readPercent` lookups,
+// splitting the rest evenly between inserts and removes. Every result feeds
+// `successes` so no lookup can be optimized away.
+template <typename Set>
+double runSetWorkload(Set& set, size_t threadCount, size_t opsPerThread, int keyRange, int readPercent,
+                      size_t& successes)
+{
+    vector<thread> workers;
+    atomic<size_t> total(0);
+    Clock::time_point start = Clock::now();
+    for (size_t t = 0; t < threadCount; t++)
+    {
+        workers.push_back(thread([&set, &total, t, opsPerThread, keyRange, readPercent]() {
+            mt19937 rng(1000 + t);
+            size_t done = 0;
+            for (size_t i = 0; i < opsPerThread; i++)
+            {
+                int key = rng() % keyRange;
+                int roll = rng() % 100;
+                if (roll < readPercent)
+                    done += set.contains(key);
+                else if (roll % 2 == 0)
+                    done += set.insert(key);
+                else
+                    done += set.remove(key);
+            }
+            total += done;
+        }));
+    }
+    for (size_t t = 0; t < workers.size(); t++)
+    {
+        workers[t].join();
+    }
+    successes = total;
+    return secondsSince(start);
+}
+
+void benchConcurrentBST(size_t count)
+{
+    const int keyRange = 1 << 20;
+    size_t ops = count / 5;
+    cout << "\nConcurrent BST, " << ops << " operations per run over " << keyRange << " keys (hardware threads: "
+         << thread::hardware_concurrency() << ")\n";
+    vector<int> prefill(keyRange / 2);
+    mt19937 rng(5);
+    for (size_t i = 0; i < prefill.size(); i++)
+    {
+        prefill[i] = rng() % keyRange;
+    }
+    const int readPercents[] = { 90, 50 };
+    const size_t threadCounts[] = { 1, 2, 4, 8 };
+    for (size_t r = 0; r < 2; r++)
+    {
+        cout << readPercents[r] << "% lookups\n";
+        for (size_t i = 0; i < 4; i++)
+        {
+            size_t threads = threadCounts[i];
+            LockedBST locked;
+            ConcurrentBST lockFree;
+            streambuf* saved = cout.rdbuf(nullptr);
+            for (size_t j = 0; j < prefill.size(); j++)
+            {
+                locked.insert(prefill[j]);
+                lockFree.insert(prefill[j]);
+            }
+            size_t lockedSuccesses = 0;
+            size_t lockFreeSuccesses = 0;
+            double lockedSeconds = runSetWorkload(locked, threads, ops / threads, keyRange, readPercents[r], lockedSuccesses);
+            double lockFreeSeconds = runSetWorkload(lockFree, threads, ops / threads, keyRange, readPercents[r], lockFreeSuccesses);
+            cout.rdbuf(saved);
+            cout << threads << " threads: locked BST " << ops / lockedSeconds / 1e6 << " M/s, ConcurrentBST "
+                 << ops / lockFreeSeconds / 1e6 << " M/s (" << lockedSuccesses << " / " << lockFreeSuccesses
+                 << " successful operations)\n";
+        }
+    }
+}
+
+// ==================== Suite ====================
+
+enum Workload
+{
+    UniformWorkload,
+    SortedWorkload,
+    ReverseWorkload,
+    ZipfianWorkload,
+    DuplicateHeavyWorkload,
+    SharedPrefixWorkload,
+    WorkloadCount
+};
+
+const char* const kWorkloadNames[WorkloadCount] = { "uniform", "sorted", "reverse", "zipfian", "duplicates", "strings" };
+
+enum SuiteOp
+{
+    InsertOp = 1,
+    DeleteOp = 2,
+    LookupOp = 4,
+    TraversalOp = 8,
+    DisplayOp = 16
+};
+
+// Zipfian ranks are drawn over at most this many distinct keys, so the CDF
+// table stays small at any size.
+const size_t kZipfKeys = 1 << 20;
+// Latencies are sampled on every stride-th operation so that no more than
+// this many are kept per measurement.
+const size_t kMaxLatencySamples = 1 << 20;
+// Display renders the whole tree, so larger trees are not displayed.
+const size_t kMaxDisplaySize = 1 << 16;
+// A plain BST fed sorted keys is a list, and Zipfian copies of a hot key
+// chain up the same way; past this size inserts would take minutes to hours.
+const size_t kMaxDegenerateSize = 1 << 15;
+
+// Zero-padded with the sign bit flipped, so string order matches int order.
+string keyString(int key, bool sharedPrefix)
+{
+    char digits[16];
+    snprintf(digits, sizeof(digits), "%010u", static_cast<unsigned>(key) ^ 0x80000000u);
+    return sharedPrefix ? "/var/spool/queue/shared/prefix/for/every/key/" + string(digits) : string(digits);
+}
+
+vector<int> makeWorkload(Workload workload, size_t count, mt19937& rng)
+{
+    vector<int> keys(count);
+    if (workload == SortedWorkload || workload == ReverseWorkload)
+    {
+        for (size_t i = 0; i < count; i++)
+        {
+            keys[i] = static_cast<int>(workload == SortedWorkload ? i : count - 1 - i);
+        }
+    }
+    else if (workload == ZipfianWorkload)
+    {
+        // Ranks follow P(r) ~ 1 / r^0.99; multiplying by an odd constant
+        // scatters them so popular keys are not also the smallest.
+        size_t distinct = count < kZipfKeys ? count : kZipfKeys;
+        vector<double> cdf(distinct);
+        double total = 0;
+        for (size_t r = 0; r < distinct; r++)
+        {
+            total += 1.0 / pow(r + 1.0, 0.99);
+            cdf[r] = total;
+        }
+        uniform_real_distribution<double> uniform(0, total);
+        for (size_t i = 0; i < count; i++)
+        {
+            size_t rank = lower_bound(cdf.begin(), cdf.end(), uniform(rng)) - cdf.begin();
+            rank = rank < distinct ? rank : distinct - 1;
+            keys[i] = static_cast<int>(static_cast<uint32_t>(rank * 2654435761u) >> 1);
+        }
+    }
+    else if (workload == DuplicateHeavyWorkload)
+    {
+        uint32_t distinct = static_cast<uint32_t>(count / 100 + 1);
+        for (size_t i = 0; i < count; i++)
+        {
+            keys[i] = rng() % distinct;
+        }
+    }
+    else
+    {
+        for (size_t i = 0; i < count; i++)
+        {
+            keys[i] = rng();
+        }
+    }
+    return keys;
+}
+
+struct SuiteResult
+{
+    string structure;
+    string workload;
+    size_t size;
+    string op;
+    size_t count;
+    double seconds;
+    double p50;
+    double p99;
+    double p999;
+    // Why the operation was not measured; empty for measured rows.
+    string skipped;
+};
+
+SuiteResult skippedResult(const string& reason)
+{
+    SuiteResult result;
+    result.count = 0;
+    result.seconds = 0;
+    result.p50 = result.p99 = result.p999 = 0;
+    result.skipped = reason;
+    return result;
+}
+
+class LatencyRecorder
+{
+private:
+    vector<uint64_t> samples;
+
+    double percentile(double q)
+    {
+        size_t index = static_cast<size_t>(q * samples.size());
+        index = index < samples.size() ? index : samples.size() - 1;
+        nth_element(samples.begin(), samples.begin() + index, samples.end());
+        return samples[index];
+    }
+
+public:
+    // Runs op(i) for i in [0, count), timing every stride-th call.
+    template <typename Op>
+    SuiteResult measure(size_t count, Op op)
+    {
+        size_t stride = count > kMaxLatencySamples ? (count + kMaxLatencySamples - 1) / kMaxLatencySamples : 1;
+        samples.clear();
+        samples.reserve(count / stride + 1);
+        Clock::time_point start = Clock::now();
+        for (size_t i = 0; i < count; i++)
+        {
+            if (i % stride != 0)
+            {
+                op(i);
+                continue;
+            }
+            Clock::time_point before = Clock::now();
+            op(i);
+            samples.push_back(chrono::duration_cast<chrono::nanoseconds>(Clock::now() - before).count());
+        }
+        SuiteResult result;
+        result.count = count;
+        result.seconds = secondsSince(start);
+        result.p50 = percentile(0.5);
+        result.p99 = percentile(0.99);
+        result.p999 = percentile(0.999);
+        return result;
+    }
+};
+
+// Results nobody reads are stored here so the lookups cannot be elided.
+volatile size_t suiteSink;
+
+// One adapter per structure gives the suite a common shape. kOps names the
+// operations the structure has; the others are never called. Heaps and
+// BinaryTree delete from their own end, so they ignore the key.
+struct BSTSubject
+{
+    typedef int Key;
+    static const unsigned kOps = InsertOp | DeleteOp | LookupOp | TraversalOp | DisplayOp;
+    static const char* name() { return "BST"; }
+    BST tree;
+    void insert(int key) { tree.insert(key); }
+    void remove(int key) { tree.remove(key); }
+    bool lookup(int key) { return tree.contains(key); }
+    void traverse() { tree.levelOrderTraversal(); }
+    void display() { tree.display(); }
+};
+
+struct BinaryTreeSubject
+{
+    typedef int Key;
+    static const unsigned kOps = InsertOp | DeleteOp | LookupOp | DisplayOp;
+    static const char* name() { return "BinaryTree"; }
+    BinaryTree tree;
+    void insert(int key) { tree.insert(key); }
+    void remove(int) { tree.removeLast(); }
+    bool lookup(int key) { return tree.exists(key); }
+    void traverse() {}
+    void display() { tree.display(); }
+};
+
+struct HeapSubject
+{
+    typedef int Key;
+    static const unsigned kOps = InsertOp | DeleteOp | DisplayOp;
+    static const char* name() { return "Heap"; }
+    Heap heap;
+    void insert(int key) { heap.insert(key); }
+    void remove(int) { heap.removeRoot(); }
+    bool lookup(int) { return false; }
+    void traverse() {}
+    void display() { heap.display(); }
+};
+
+struct RBTreeSubject
+{
+    typedef string Key;
+    static const unsigned kOps = InsertOp | DeleteOp | LookupOp | TraversalOp | DisplayOp;
+    static const char* name() { return "RBTree"; }
+    RBTree tree;
+    void insert(const string& key) { tree.insertUnique(key); }
+    void remove(const string& key) { tree.deleteNode(key); }
+    bool lookup(const string& key) { return tree.contains(key); }
+    void traverse() { tree.dfs(); }
+    void display() { tree.printRBT(); }
+};
+
+struct MultisetSubject
+{
+    typedef int Key;
+    static const unsigned kOps = InsertOp | DeleteOp | LookupOp | TraversalOp;
+    static const char* name() { return "std::multiset<int>"; }
+    multiset<int> values;
+    long long sink;
+    MultisetSubject() : sink(0) {}
+    void insert(int key) { values.insert(key); }
+    void remove(int key)
+    {
+        multiset<int>::iterator it = values.find(key);
+        if (it != values.end())
+            values.erase(it);
+    }
+    bool lookup(int key) { return values.find(key) != values.end(); }
+    void traverse() { sink += accumulate(values.begin(), values.end(), 0LL); }
+    void display() {}
+};
+
+struct StringSetSubject
+{
+    typedef string Key;
+    static const unsigned kOps = InsertOp | DeleteOp | LookupOp | TraversalOp;
+    static const char* name() { return "std::set<string>"; }
+    set<string> values;
+    size_t sink;
+    StringSetSubject() : sink(0) {}
+    void insert(const string& key) { values.insert(key); }
+    void remove(const string& key) { values.erase(key); }
+    bool lookup(const string& key) { return values.count(key) != 0; }
+    void traverse()
+    {
+        for (set<string>::const_iterator it = values.begin(); it != values.end(); ++it)
+            sink += it->size();
+    }
+    void display() {}
+};
+
+struct PriorityQueueSubject
+{
+    typedef int Key;
+    static const unsigned kOps = InsertOp | DeleteOp;
+    static const char* name() { return "std::priority_queue<int>"; }
+    priority_queue<int, vector<int>, greater<int>> heap;
+    void insert(int key) { heap.push(key); }
+    void remove(int) { heap.pop(); }
+    bool lookup(int) { return false; }
+    void traverse() {}
+    void display() {}
+};
+
+void convertKeys(const vector<int>& keys, bool, vector<int>& out)
+{
+    out = keys;
+}
+
+void convertKeys(const vector<int>& keys, bool sharedPrefix, vector<string>& out)
+{
+    out.resize(keys.size());
+    for (size_t i = 0; i < keys.size(); i++)
+    {
+        out[i] = keyString(keys[i], sharedPrefix);
+    }
+}
+
+void printSuiteRow(const string& structure, const string& workload, const string& size, const string& op,
+                   const string& rate, const string& p50, const string& p99, const string& p999,
+                   const string& note = "")
+{
+    cout << left << setw(26) << structure << setw(12) << workload << right << setw(11) << size << "  " << left
+         << setw(10) << op << right << setw(14) << rate << setw(12) << p50 << setw(12) << p99 << setw(12) << p999
+         << (note.empty() ? "" : "  ") << note << "\n";
+}
+
+string wholeNumber(double value)
+{
+    return to_string(static_cast<long long>(value + 0.5));
+}
+
+void printSuiteResult(const SuiteResult& result)
+{
+    if (!result.skipped.empty())
+    {
+        printSuiteRow(result.structure, result.workload, to_string(result.size), result.op, "skipped", "-", "-", "-",
+                      result.skipped);
+        return;
+    }
+    printSuiteRow(result.structure, result.workload, to_string(result.size), result.op,
+                  wholeNumber(result.count / result.seconds), wholeNumber(result.p50), wholeNumber(result.p99),
+                  wholeNumber(result.p999));
+}
+
+template <typename Subject>
+void recordSuiteCase(Workload workload, size_t n, vector<SuiteResult>& caseResults, const vector<string>& opNames,
+                     vector<SuiteResult>& results)
+{
+    for (size_t i = 0; i < caseResults.size(); i++)
+    {
+        caseResults[i].structure = Subject::name();
+        caseResults[i].workload = kWorkloadNames[workload];
+        caseResults[i].size = n;
+        caseResults[i].op = opNames[i];
+        printSuiteResult(caseResults[i]);
+        results.push_back(caseResults[i]);
+    }
+}
+
+// Inserts every key, looks each one up in shuffled order, traverses and
+// displays, then deletes in shuffled order. Output produced by the
+// structures themselves goes to a DiscardBuffer, so display and traversal
+// still pay for formatting it. Operations that are not run are still
+// recorded, as skipped rows with the reason.
+template <typename Subject>
+void runSuiteCase(Workload workload, const vector<int>& keys, mt19937& rng, vector<SuiteResult>& results)
+{
+    typedef typename Subject::Key Key;
+    bool stringKeys = is_same<Key, string>::value;
+    if (workload == SharedPrefixWorkload && !stringKeys)
+    {
+        return;
+    }
+    size_t n = keys.size();
+    vector<SuiteResult> caseResults;
+    vector<string> opNames;
+    if (is_same<Subject, BSTSubject>::value
+        && (workload == SortedWorkload || workload == ReverseWorkload || workload == ZipfianWorkload)
+        && n > kMaxDegenerateSize)
+    {
+        const SuiteOp ops[] = { InsertOp, LookupOp, TraversalOp, DisplayOp, DeleteOp };
+        const char* const names[] = { "insert", "lookup", "traversal", "display", "delete" };
+        for (int i = 0; i < 5; i++)
+        {
+            if (Subject::kOps & ops[i])
+            {
+                caseResults.push_back(skippedResult("tree degenerates into chains, O(n^2) inserts"));
+                opNames.push_back(names[i]);
+            }
+        }
+        recordSuiteCase<Subject>(workload, n, caseResults, opNames, results);
+        return;
+    }
+    vector<Key> ordered;
+    convertKeys(keys, workload == SharedPrefixWorkload, ordered);
+    vector<Key> shuffled(ordered);
+    shuffle(shuffled.begin(), shuffled.end(), rng);
+
+    Subject* subject = new Subject;
+    LatencyRecorder recorder;
+    DiscardBuffer discard;
+    size_t found = 0;
+    streambuf* saved = cout.rdbuf(&discard);
+    if (Subject::kOps & InsertOp)
+    {
+        caseResults.push_back(recorder.measure(n, [&](size_t i) { subject->insert(ordered[i]); }));
+        opNames.push_back("insert");
+    }
+    if (Subject::kOps & LookupOp)
+    {
+        caseResults.push_back(recorder.measure(n, [&](size_t i) { found += subject->lookup(shuffled[i]); }));
+        opNames.push_back("lookup");
+        suiteSink += found;
+    }
+    size_t repeats = n <= (1 << 20) ? 3 : 1;
+    if (Subject::kOps & TraversalOp)
+    {
+        caseResults.push_back(recorder.measure(repeats, [&](size_t) { subject->traverse(); }));
+        opNames.push_back("traversal");
+    }
+    if (Subject::kOps & DisplayOp)
+    {
+        if (n <= kMaxDisplaySize)
+            caseResults.push_back(recorder.measure(repeats, [&](size_t) { subject->display(); }));
+        else
+            caseResults.push_back(skippedResult("display limited to " + to_string(kMaxDisplaySize) + " keys"));
+        opNames.push_back("display");
+    }
+    if (Subject::kOps & DeleteOp)
+    {
+        caseResults.push_back(recorder.measure(n, [&](size_t i) { subject->remove(shuffled[i]); }));
+        opNames.push_back("delete");
+    }
+    delete subject;
+    cout.rdbuf(saved);
+    recordSuiteCase<Subject>(workload, n, caseResults, opNames, results);
+}
+
+bool writeSuiteCsv(const string& path, const vector<SuiteResult>& results)
+{
+    ofstream out(path.c_str());
+    out << "structure,workload,size,op,count,seconds,ops_per_second,p50_ns,p99_ns,p999_ns,status,reason\n";
+    for (size_t i = 0; i < results.size(); i++)
+    {
+        const SuiteResult& r = results[i];
+        out << "\"" << r.structure << "\"," << r.workload << "," << r.size << "," << r.op << ",";
+        if (!r.skipped.empty())
+        {
+            out << ",,,,,,skipped,\"" << r.skipped << "\"\n";
+            continue;
+        }
+        out << r.count << "," << r.seconds << "," << r.count / r.seconds << "," << r.p50 << "," << r.p99 << ","
+            << r.p999 << ",ok,\n";
+    }
+    return static_cast<bool>(out);
+}
+
+bool writeSuiteJson(const string& path, const vector<SuiteResult>& results)
+{
+    ofstream out(path.c_str());
+    out << "[\n";
+    for (size_t i = 0; i < results.size(); i++)
+    {
+        const SuiteResult& r = results[i];
+        out << "  {\"structure\": \"" << r.structure << "\", \"workload\": \"" << r.workload << "\", \"size\": "
+            << r.size << ", \"op\": \"" << r.op << "\", ";
+        if (!r.skipped.empty())
+        {
+            out << "\"status\": \"skipped\", \"reason\": \"" << r.skipped << "\"}";
+        }
+        else
+        {
+            out << "\"status\": \"ok\", \"count\": " << r.count << ", \"seconds\": " << r.seconds
+                << ", \"ops_per_second\": " << r.count / r.seconds << ", \"p50_ns\": " << r.p50 << ", \"p99_ns\": "
+                << r.p99 << ", \"p999_ns\": " << r.p999 << "}";
+        }
+        out << (i + 1 < results.size() ? "," : "") << "\n";
+    }
+    out << "]\n";
+    return static_cast<bool>(out);
+}
+
+vector<string> splitList(const string& list)
+{
+    vector<string> items;
+    stringstream stream(list);
+    string item;
+    while (getline(stream, item, ','))
+    {
+        if (!item.empty())
+            items.push_back(item);
+    }
+    return items;
+}
+
+// "1000", "10K" and "100M" are all accepted.
+bool parseSize(const string& text, size_t& size)
+{
+    char* end = nullptr;
+    unsigned long long value = strtoull(text.c_str(), &end, 10);
+    if (end == text.c_str())
+        return false;
+    if (*end == 'K' || *end == 'k')
+        value *= 1000, end++;
+    else if (*end == 'M' || *end == 'm')
+        value *= 1000000, end++;
+    size = value;
+    return *end == '\0' && value > 0;
+}
+
+int runSuite(int argc, char* argv[])
+{
+    // 10M and 100M are opt-in; see the note at the top of the file.
+    vector<string> sizeList = splitList("1K,10K,100K,1M");
+    vector<string> workloadList;
+    vector<string> structureList;
+    string csvPath;
+    string jsonPath;
+    for (int i = 2; i < argc; i++)
+    {
+        string flag = argv[i];
+        if (i + 1 >= argc)
+        {
+            cerr << "Missing value for " << flag << "\n";
+            return 1;
+        }
+        string value = argv[++i];
+        if (flag == "--sizes")
+            sizeList = splitList(value);
+        else if (flag == "--workloads")
+            workloadList = splitList(value);
+        else if (flag == "--structures")
+            structureList = splitList(value);
+        else if (flag == "--csv")
+            csvPath = value;
+        else if (flag == "--json")
+            jsonPath = value;
+        else
+        {
+            cerr << "Unknown option " << flag << "\n";
+            return 1;
+        }
+    }
+    vector<size_t> sizes;
+    for (size_t i = 0; i < sizeList.size(); i++)
+    {
+        size_t size;
+        if (!parseSize(sizeList[i], size))
+        {
+            cerr << "Invalid size " << sizeList[i] << "\n";
+            return 1;
+        }
+        sizes.push_back(size);
+    }
+    vector<Workload> workloads;
+    for (int w = 0; w < WorkloadCount; w++)
+    {
+        if (workloadList.empty() || find(workloadList.begin(), workloadList.end(), kWorkloadNames[w]) != workloadList.end())
+            workloads.push_back(static_cast<Workload>(w));
+    }
+    if (workloads.empty())
+    {
+        cerr << "No known workload selected.\n";
+        return 1;
+    }
+    struct Entry
+    {
+        const char* name;
+        void (*run)(Workload, const vector<int>&, mt19937&, vector<SuiteResult>&);
+    };
+    const Entry entries[] = {
+        { BSTSubject::name(), runSuiteCase<BSTSubject> },
+        { BinaryTreeSubject::name(), runSuiteCase<BinaryTreeSubject> },
+        { HeapSubject::name(), runSuiteCase<HeapSubject> },
+        { RBTreeSubject::name(), runSuiteCase<RBTreeSubject> },
+        { MultisetSubject::name(), runSuiteCase<MultisetSubject> },
+        { StringSetSubject::name(), runSuiteCase<StringSetSubject> },
+        { PriorityQueueSubject::name(), runSuiteCase<PriorityQueueSubject> },
+    };
+    printSuiteRow("structure", "workload", "size", "op", "ops/s", "p50 ns", "p99 ns", "p999 ns");
+    vector<SuiteResult> results;
+    for (size_t s = 0; s < sizes.size(); s++)
+    {
+        for (size_t w = 0; w < workloads.size(); w++)
+        {
+            mt19937 rng(12345 + s);
+            vector<int> keys = makeWorkload(workloads[w], sizes[s], rng);
+            for (size_t e = 0; e < sizeof(entries) / sizeof(entries[0]); e++)
+            {
+                if (!structureList.empty()
+                    && find(structureList.begin(), structureList.end(), entries[e].name) == structureList.end())
+                    continue;
+                entries[e].run(workloads[w], keys, rng, results);
+            }
+        }
+    }
+    if (!csvPath.empty() && !writeSuiteCsv(csvPath, results))
+    {
+        cerr << "Cannot write " << csvPath << "\n";
+        return 1;
+    }
+    if (!jsonPath.empty() && !writeSuiteJson(jsonPath, results))
+    {
+        cerr << "Cannot write " << jsonPath << "\n";
+        return 1;
+    }
+    return 0;
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc > 1 && strcmp(argv[1], "--suite") == 0)
+    {
+        return runSuite(argc, argv);
+    }
+    size_t count = argc > 1 ? strtoul(argv[1], nullptr, 10) : 10000000;
+    mt19937 rng(12345);
+    vector<int> values(count);
+    for (size_t i = 0; i < count; i++)
+    {
+        values[i] = rng();
+    }
+    cout << "Heap push/pop of " << count << " random ints\n";
+    {
+        RuntimeFlagHeap heap(true);
+        benchHeap("runtime flag, min", heap, values);
+    }
+    {
+        RuntimeFlagHeap heap(false);
+        benchHeap("runtime flag, max", heap, values);
+    }
+    {
+        BasicHeap<int, less<int>> heap;
+        benchHeap("BasicHeap<less>", heap, values);
+    }
+    {
+        BasicHeap<int, greater<int>> heap;
+        benchHeap("BasicHeap<greater>", heap, values);
+    }
+    cout << "\nHeap arity\n";
+    {
+        BasicHeap<int, less<int>, 4> heap;
+        benchHeap("4-ary BasicHeap<less>", heap, values);
+    }
+    {
+        BasicHeap<int, less<int>, 8> heap;
+        benchHeap("8-ary BasicHeap<less>", heap, values);
+    }
+    {
+        BasicHeap<int, greater<int>, 8> heap;
+        benchHeap("8-ary BasicHeap<greater>", heap, values);
+    }
+    benchSiftStrategies("random ints", values);
+    benchBulkLoad(values, values.size() / 10);
+    benchBulkLoad(values, values.size() * 9 / 10);
+    vector<int> descending(values);
+    sort(descending.begin(), descending.end());
+    reverse(descending.begin(), descending.end());
+    cout << "\n(descending input, worst case for sift-up)";
+    benchBulkLoad(descending, values.size() / 10);
+    benchPriorityUpdates(values, values.size() / 10);
+    benchMerges(values, 64);
+    benchMultiQueue(values);
+    benchExternalHeap(values);
+    benchTopK(values, 100);
+    benchTopK(values, 100000);
+    benchFrozenLookups(values);
+    benchBuildFrom(values);
+    benchNodePacking(vector<int>(values.begin(), values.begin() + values.size() / 4));
+    benchConcurrentBST(count);
+    vector<string> keys(count / 10);
+    for (size_t i = 0; i < keys.size(); i++)
+    {
+        keys[i] = "/var/spool/queue/shared/prefix/for/every/key/" + to_string(rng());
+    }
+    benchSiftStrategies("strings with a long shared prefix", keys);
+    return 0;
+}
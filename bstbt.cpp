@@ -6,6 +6,27 @@
 #include <algorithm>
 #include <limits>
 #include <cstdlib>
+#include <unordered_map>
+#include <functional>
+#include <utility>
+#include <cstdint>
+#include <new>
+#include <type_traits>
+#include <iterator>
+#include <mutex>
+#include <atomic>
+#include <thread>
+#include <cstdio>
+
+#include "profile.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define TREES_HAVE_SSE2
+#include <emmintrin.h>
+#endif
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
 
 using namespace std;
 
@@ -44,96 +65,475 @@ void waitForEnter()
     cin.get();
 }
 
+// ==================== Low-Level Helpers ====================
+
+const size_t kCacheLineSize = 64;
+
+// Hands out cache-line aligned buffers, so that fixed-size groups of values
+// (a heap's siblings, a frozen BST's subtree blocks) never straddle two lines.
+template <typename T>
+struct CacheAlignedAllocator
+{
+    typedef T value_type;
+
+    CacheAlignedAllocator() {}
+    template <typename U>
+    CacheAlignedAllocator(const CacheAlignedAllocator<U>&) {}
+
+    T* allocate(size_t n)
+    {
+        char* raw = static_cast<char*>(::operator new(n * sizeof(T) + kCacheLineSize + sizeof(void*)));
+        uintptr_t aligned = (reinterpret_cast<uintptr_t>(raw) + sizeof(void*) + kCacheLineSize - 1)
+            & ~static_cast<uintptr_t>(kCacheLineSize - 1);
+        reinterpret_cast<void**>(aligned)[-1] = raw;
+        return reinterpret_cast<T*>(aligned);
+    }
+
+    void deallocate(T* p, size_t)
+    {
+        ::operator delete(reinterpret_cast<void**>(p)[-1]);
+    }
+};
+
+template <typename T, typename U>
+bool operator==(const CacheAlignedAllocator<T>&, const CacheAlignedAllocator<U>&) { return true; }
+
+template <typename T, typename U>
+bool operator!=(const CacheAlignedAllocator<T>&, const CacheAlignedAllocator<U>&) { return false; }
+
+inline unsigned lowestSetBit(unsigned mask)
+{
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanForward(&index, mask);
+    return index;
+#else
+    return __builtin_ctz(mask);
+#endif
+}
+
+inline unsigned lowestSetBit64(unsigned long long mask)
+{
+#if defined(_MSC_VER) && defined(_M_X64)
+    unsigned long index;
+    _BitScanForward64(&index, mask);
+    return index;
+#elif defined(_MSC_VER)
+    unsigned long index;
+    if (_BitScanForward(&index, static_cast<unsigned long>(mask)))
+        return index;
+    _BitScanForward(&index, static_cast<unsigned long>(mask >> 32));
+    return index + 32;
+#else
+    return __builtin_ctzll(mask);
+#endif
+}
+
+// A hint only: never faults, but the address must still be a valid pointer.
+inline void prefetchRead(const void* address)
+{
+#if defined(__GNUC__)
+    __builtin_prefetch(address);
+#elif defined(TREES_HAVE_SSE2)
+    _mm_prefetch(static_cast<const char*>(address), _MM_HINT_T0);
+#else
+    (void)address;
+#endif
+}
+
+// Accepts and drops everything written to it. Swapped in for cout's buffer,
+// it lets the structures format their output as usual without printing it.
+class DiscardBuffer : public streambuf
+{
+protected:
+    int overflow(int c) { return c; }
+    streamsize xsputn(const char*, streamsize count) { return count; }
+};
+
+// Fixed-size node allocator: nodes are carved out of chunks that start at 16
+// slots and double up to 1024, handed out in address order, and freed nodes
+// go on an intrusive free list for reuse. Chunks are only released together,
+// by clear() or when the pool dies, so tearing down a whole structure costs
+// one free per chunk. Two pools can be spliced in O(1), which lets a node
+// change owners without being copied.
+template <typename T>
+class NodePool
+{
+private:
+    union Slot
+    {
+        Slot* next;
+        typename aligned_storage<sizeof(T), alignof(T)>::type storage;
+    };
+
+    struct Chunk
+    {
+        Chunk* next;
+        Slot* slots;
+        size_t size;
+    };
+
+    static const size_t kFirstChunkSlots = 16;
+    static const size_t kMaxChunkSlots = 1024;
+
+    Chunk* chunks;
+    Chunk* lastChunk;
+    Slot* freeList;
+    Slot* lastFree;
+    size_t unused;
+    size_t chunkSlots;
+
+    NodePool(const NodePool&);
+    NodePool& operator=(const NodePool&);
+
+    void addChunk(size_t size)
+    {
+        Chunk* chunk = new Chunk;
+        chunk->slots = new Slot[size];
+        chunk->size = size;
+        chunk->next = chunks;
+        chunks = chunk;
+        if (lastChunk == nullptr)
+            lastChunk = chunk;
+        unused = size;
+    }
+
+    Slot* take()
+    {
+        if (freeList != nullptr)
+        {
+            Slot* slot = freeList;
+            freeList = slot->next;
+            if (freeList == nullptr)
+                lastFree = nullptr;
+            return slot;
+        }
+        if (unused == 0)
+        {
+            addChunk(chunkSlots);
+            if (chunkSlots < kMaxChunkSlots)
+                chunkSlots *= 2;
+        }
+        return &chunks->slots[chunks->size - unused--];
+    }
+
+public:
+    NodePool()
+        : chunks(nullptr), lastChunk(nullptr), freeList(nullptr), lastFree(nullptr), unused(0), chunkSlots(kFirstChunkSlots) {}
+
+    // Does not run destructors; owners destroy their live nodes first.
+    ~NodePool()
+    {
+        clear();
+    }
+
+    // Drops every node at once without running destructors, so it is only
+    // for trivially destructible nodes or owners that destroyed theirs.
+    void clear()
+    {
+        while (chunks != nullptr)
+        {
+            Chunk* next = chunks->next;
+            delete[] chunks->slots;
+            delete chunks;
+            chunks = next;
+        }
+        lastChunk = nullptr;
+        freeList = lastFree = nullptr;
+        unused = 0;
+        chunkSlots = kFirstChunkSlots;
+    }
+
+    // Makes the next count fresh nodes one contiguous run in address order,
+    // starting a chunk of that size if the current one is too short. Nodes
+    // reused from the free list are not part of the run.
+    void reserve(size_t count)
+    {
+        if (unused < count)
+        {
+            addChunk(count);
+        }
+    }
+
+    template <typename... Args>
+    T* create(Args&&... args)
+    {
+        return new (&take()->storage) T(forward<Args>(args)...);
+    }
+
+    void destroy(T* node)
+    {
+        node->~T();
+        Slot* slot = reinterpret_cast<Slot*>(node);
+        slot->next = freeList;
+        if (freeList == nullptr)
+            lastFree = slot;
+        freeList = slot;
+    }
+
+    // Takes over every chunk of `other`, live nodes included. The unused tail
+    // of other's newest chunk is left idle rather than walked.
+    void splice(NodePool& other)
+    {
+        if (other.chunks == nullptr)
+        {
+            return;
+        }
+        if (chunks == nullptr)
+        {
+            swap(chunks, other.chunks);
+            swap(lastChunk, other.lastChunk);
+            swap(freeList, other.freeList);
+            swap(lastFree, other.lastFree);
+            swap(unused, other.unused);
+            swap(chunkSlots, other.chunkSlots);
+            return;
+        }
+        lastChunk->next = other.chunks;
+        lastChunk = other.lastChunk;
+        if (other.freeList != nullptr)
+        {
+            if (freeList == nullptr)
+                freeList = other.freeList;
+            else
+                lastFree->next = other.freeList;
+            lastFree = other.lastFree;
+        }
+        other.chunks = other.lastChunk = nullptr;
+        other.freeList = other.lastFree = nullptr;
+        other.unused = 0;
+    }
+};
+
+// LSD radix sort, one byte per pass, with the sign bit flipped so negative
+// values sort first. All four byte histograms come from one read pass, and a
+// pass is skipped when every value has the same byte there, so narrow key
+// ranges take fewer passes.
+inline void radixSort(vector<int>& values)
+{
+    size_t n = values.size();
+    if (n < 2)
+    {
+        return;
+    }
+    size_t counts[4][256] = {};
+    for (size_t i = 0; i < n; i++)
+    {
+        uint32_t key = static_cast<uint32_t>(values[i]) ^ 0x80000000u;
+        counts[0][key & 0xFF]++;
+        counts[1][(key >> 8) & 0xFF]++;
+        counts[2][(key >> 16) & 0xFF]++;
+        counts[3][key >> 24]++;
+    }
+    vector<int> buffer(n);
+    for (unsigned pass = 0; pass < 4; pass++)
+    {
+        unsigned shift = 8 * pass;
+        uint32_t first = ((static_cast<uint32_t>(values[0]) ^ 0x80000000u) >> shift) & 0xFF;
+        if (counts[pass][first] == n)
+        {
+            continue;
+        }
+        size_t offsets[256];
+        size_t total = 0;
+        for (unsigned digit = 0; digit < 256; digit++)
+        {
+            offsets[digit] = total;
+            total += counts[pass][digit];
+        }
+        for (size_t i = 0; i < n; i++)
+        {
+            uint32_t key = static_cast<uint32_t>(values[i]) ^ 0x80000000u;
+            buffer[offsets[(key >> shift) & 0xFF]++] = values[i];
+        }
+        values.swap(buffer);
+    }
+}
+
 // ==================== Binary Search Tree (BST) Implementation ====================
 
 class BSTNode
 {
 public:
     int data;
+    int height;
+    size_t size;
     BSTNode* left;
     BSTNode* right;
-    BSTNode(int value) : data(value), left(nullptr), right(nullptr) {}
+    BSTNode(int value) : data(value), height(1), size(1), left(nullptr), right(nullptr) {}
 };
 
 class BST
 {
 private:
     BSTNode* root;
+    BSTNode* maxNode;
+    int maxLevel;
     bool allowDuplicates;
+    int displayMaxDepth;
+    size_t displayMaxWidth;
+    bool frozen;
+    vector<int, CacheAlignedAllocator<int>> frozenKeys;
+    vector<int> frozenCounts;
+    unordered_map<int, int> frozenDelta;
+    // Owns every node, so destroying the tree is one bulk release of the
+    // pool's chunks rather than a walk.
+    NodePool<BSTNode> nodes;
 
-    BSTNode* insertRecursive(BSTNode* node, int value)
+    // Scratch space reused by every walk, so descents and level-order passes
+    // allocate nothing once they have grown to the tree's size.
+    vector<BSTNode*> path;
+    vector<BSTNode*> walk;
+
+    // check.cpp compares the cached maximum against a walk of the right spine.
+    friend struct BSTReference;
+
+    // Refreshes height and size bottom-up along the recorded descent.
+    void updatePath()
     {
-        if (node == nullptr)
-        {
-            return new BSTNode(value);
-        }
-        if (value < node->data)
-        {
-            node->left = insertRecursive(node->left, value);
-        }
-        else if (value > node->data)
+        for (size_t i = path.size(); i-- > 0;)
         {
-            node->right = insertRecursive(node->right, value);
+            updateNode(path[i]);
         }
-        else
+    }
+
+    BSTNode* insertIterative(int value)
+    {
+        path.clear();
+        BSTNode** link = &root;
+        while (*link != nullptr)
         {
-            if (allowDuplicates)
-            {
-                node->right = insertRecursive(node->right, value);
-            }
-            else
+            BSTNode* node = *link;
+            if (value == node->data && !allowDuplicates)
             {
                 cout << "Duplicate value " << value << " is not allowed.\n";
+                return nullptr;
             }
+            path.push_back(node);
+            link = value < node->data ? &node->left : &node->right;
         }
-        return node;
+        BSTNode* added = nodes.create(value);
+        *link = added;
+        updatePath();
+        return added;
     }
 
-    BSTNode* deleteRecursive(BSTNode* node, int value, bool& found)
+    // Unlinks the first node holding value on the search path. A node with
+    // two children takes its in-order successor's value instead, and the
+    // successor, which has no left child, is unlinked in its place.
+    bool deleteIterative(int value)
     {
+        path.clear();
+        BSTNode** link = &root;
+        while (*link != nullptr && (*link)->data != value)
+        {
+            path.push_back(*link);
+            link = value < (*link)->data ? &(*link)->left : &(*link)->right;
+        }
+        BSTNode* node = *link;
         if (node == nullptr)
         {
-            return node;
+            return false;
         }
-        if (value < node->data)
+        if (node->left != nullptr && node->right != nullptr)
         {
-            node->left = deleteRecursive(node->left, value, found);
+            path.push_back(node);
+            link = &node->right;
+            while ((*link)->left != nullptr)
+            {
+                path.push_back(*link);
+                link = &(*link)->left;
+            }
+            node->data = (*link)->data;
+            node = *link;
         }
-        else if (value > node->data)
+        *link = node->left != nullptr ? node->left : node->right;
+        nodes.destroy(node);
+        updatePath();
+        return true;
+    }
+
+    int getHeight(BSTNode* node)
+    {
+        return node == nullptr ? 0 : node->height;
+    }
+
+    size_t getSize(BSTNode* node) const
+    {
+        return node == nullptr ? 0 : node->size;
+    }
+
+    void updateNode(BSTNode* node)
+    {
+        node->height = max(getHeight(node->left), getHeight(node->right)) + 1;
+        node->size = getSize(node->left) + getSize(node->right) + 1;
+    }
+
+    // The maximum is the end of the right spine; its level is the spine length.
+    void findMax()
+    {
+        maxNode = root;
+        maxLevel = root == nullptr ? 0 : 1;
+        while (maxNode != nullptr && maxNode->right != nullptr)
         {
-            node->right = deleteRecursive(node->right, value, found);
+            maxNode = maxNode->right;
+            maxLevel++;
         }
-        else
+    }
+
+    // Values strictly below `value`, or at most `value` when inclusive.
+    size_t countBelow(int value, bool inclusive) const
+    {
+        size_t count = 0;
+        BSTNode* node = root;
+        while (node != nullptr)
         {
-            found = true;
-            if (node->left == nullptr)
+            if (node->data < value || (inclusive && node->data == value))
             {
-                BSTNode* temp = node->right;
-                delete node;
-                return temp;
+                count += getSize(node->left) + 1;
+                node = node->right;
             }
-            else if (node->right == nullptr)
+            else
             {
-                BSTNode* temp = node->left;
-                delete node;
-                return temp;
+                node = node->left;
             }
-            BSTNode* temp = node->right;
-            while (temp->left != nullptr)
-                temp = temp->left;
-            node->data = temp->data;
-            node->right = deleteRecursive(node->right, temp->data, found);
         }
-        return node;
+        return count;
     }
 
-    int getHeight(BSTNode* node)
+    // Lays the sorted distinct keys out in Eytzinger (BFS) order: slot k has
+    // children 2k and 2k + 1, slot 0 is unused, and an in-order walk of the
+    // implicit tree visits the keys in sorted order.
+    size_t fillEytzinger(const vector<pair<int, int>>& sorted, size_t next, size_t slot)
     {
-        if (node == nullptr)
+        if (slot < frozenKeys.size())
         {
-            return 0;
+            next = fillEytzinger(sorted, next, 2 * slot);
+            frozenKeys[slot] = sorted[next].first;
+            frozenCounts[slot] = sorted[next].second;
+            next = fillEytzinger(sorted, next + 1, 2 * slot + 1);
         }
-        return max(getHeight(node->left), getHeight(node->right)) + 1;
+        return next;
+    }
+
+    // Branchless descent: each step picks a child with arithmetic instead of a
+    // branch, and the 16 descendants four levels down, which share one cache
+    // line of the aligned array, are prefetched while the current level is
+    // compared. Returns the slot of the first key >= value, or 0.
+    size_t frozenLowerBound(int value) const
+    {
+        const int* keys = frozenKeys.data();
+        size_t n = frozenKeys.size();
+        size_t slot = 1;
+        while (slot < n)
+        {
+            // Four levels down sits at 16 * slot; near the leaves that is past
+            // the end, and even forming such a pointer is undefined.
+            if (16 * slot < n)
+                prefetchRead(keys + 16 * slot);
+            slot = 2 * slot + (keys[slot] < value);
+        }
+        return slot >> (lowestSetBit64(~static_cast<unsigned long long>(slot)) + 1);
     }
 
     bool isRightSkewed(BSTNode* node)
@@ -147,67 +547,156 @@ private:
         return true;
     }
 
-    void displayHelperBalanced()
+    // One row of the balanced view. Columns count from the left edge of the
+    // full layout, which can be far wider than the screen; only text inside
+    // [windowStart, windowEnd) is kept, and first/last track the columns that
+    // hold any text at all.
+    struct DisplayRow
     {
-        int maxLevel = getHeight(root);
-        if (maxLevel == 0)
-        {
-            cout << "Tree is empty.\n";
-            return;
+        string* text;
+        unsigned long long column;
+        unsigned long long windowStart;
+        unsigned long long windowEnd;
+        unsigned long long first;
+        unsigned long long last;
+
+        void put(const string& item)
+        {
+            unsigned long long end = column + item.size();
+            first = min(first, column);
+            last = max(last, end);
+            unsigned long long from = max(column, windowStart);
+            unsigned long long to = min(end, windowEnd);
+            if (text != nullptr && from < to)
+            {
+                size_t offset = from - windowStart;
+                if (text->size() < offset)
+                {
+                    text->append(offset - text->size(), ' ');
+                }
+                text->replace(offset, to - from, item, from - column, to - from);
+            }
+            column = end;
         }
-        int spacingFactor = 2;
-        vector<BSTNode*> current;
-        current.push_back(root);
-        int level = 1;
-        while (level <= maxLevel)
-        {
-            int initialSpaces = max(0, (((1 << (maxLevel - level)) - 1)) / spacingFactor);
-            int betweenSpaces = max(0, (((1 << (maxLevel - level + 1)) - 1)) / spacingFactor);
-            cout << string(initialSpaces, ' ');
-            vector<BSTNode*> next;
+    };
+
+    // Lays out the top levels of the tree as a full 2^level slot walk would,
+    // but visits only real nodes; empty slots just advance the column. Labels
+    // wider than their slot push the rest of the row right, so neighbours and
+    // the edges between them never overwrite each other. Edges sit just
+    // outside the text of their parent. With rows == nullptr it
+    // only measures the columns the layout occupies.
+    void layoutBalanced(int levels, unsigned long long windowStart, vector<string>* rows,
+                        unsigned long long& first, unsigned long long& last)
+    {
+        DisplayRow row;
+        row.text = nullptr;
+        row.windowStart = windowStart;
+        row.windowEnd = windowStart + displayMaxWidth;
+        row.first = numeric_limits<unsigned long long>::max();
+        row.last = 0;
+        vector<pair<unsigned long long, BSTNode*>> current;
+        vector<pair<unsigned long long, BSTNode*>> next;
+        vector<pair<unsigned long long, unsigned long long>> spans;
+        current.push_back(make_pair(0ULL, root));
+        for (int level = 1; level <= levels; level++)
+        {
+            unsigned long long initialSpaces = ((1ULL << (levels - level)) - 1) / 2;
+            unsigned long long betweenSpaces = ((1ULL << (levels - level + 1)) - 1) / 2;
+            if (rows != nullptr)
+            {
+                rows->push_back(string());
+                row.text = &rows->back();
+            }
+            row.column = initialSpaces;
+            unsigned long long nextSlot = 0;
+            spans.clear();
             for (size_t i = 0; i < current.size(); i++)
             {
-                if (current[i] != nullptr)
+                unsigned long long slot = current[i].first;
+                row.column += (slot - nextSlot) * (1 + betweenSpaces);
+                if (i > 0 && row.column < spans[i - 1].second + 2)
                 {
-                    cout << current[i]->data;
-                    next.push_back(current[i]->left);
-                    next.push_back(current[i]->right);
+                    row.column = spans[i - 1].second + 2;
                 }
-                else
+                unsigned long long start = row.column;
+                row.put(to_string(current[i].second->data));
+                spans.push_back(make_pair(start, row.column));
+                row.column += betweenSpaces;
+                nextSlot = slot + 1;
+            }
+            if (level == levels)
+            {
+                break;
+            }
+            if (rows != nullptr)
+            {
+                rows->push_back(string());
+                row.text = &rows->back();
+            }
+            next.clear();
+            for (size_t i = 0; i < current.size(); i++)
+            {
+                unsigned long long slot = current[i].first;
+                BSTNode* node = current[i].second;
+                if (node->left != nullptr)
                 {
-                    cout << " ";
-                    next.push_back(nullptr);
-                    next.push_back(nullptr);
+                    row.column = spans[i].first > 0 ? spans[i].first - 1 : 0;
+                    row.put("/");
+                    next.push_back(make_pair(2 * slot, node->left));
                 }
-                if (i < current.size() - 1)
+                if (node->right != nullptr)
                 {
-                    cout << string(betweenSpaces, ' ');
+                    row.column = spans[i].second;
+                    row.put("\\");
+                    next.push_back(make_pair(2 * slot + 1, node->right));
                 }
             }
-            cout << "\n";
-            if (level < maxLevel)
+            current.swap(next);
+        }
+        first = row.first;
+        last = row.last;
+    }
+
+    // Every level shown doubles the spacing of the levels above it, so the
+    // view keeps as many levels as fit side by side in the display width,
+    // up to the depth limit, and starts at the first occupied column.
+    void displayHelperBalanced()
+    {
+        int height = getHeight(root);
+        if (height == 0)
+        {
+            cout << "Tree is empty.\n";
+            return;
+        }
+        int maxLevels = min(height, displayMaxDepth);
+        int levels = 1;
+        unsigned long long first;
+        unsigned long long last;
+        layoutBalanced(levels, 0, nullptr, first, last);
+        while (levels < maxLevels)
+        {
+            unsigned long long deeperFirst;
+            unsigned long long deeperLast;
+            layoutBalanced(levels + 1, 0, nullptr, deeperFirst, deeperLast);
+            if (deeperLast - deeperFirst > displayMaxWidth)
             {
-                int safeInitialSpaces = (initialSpaces > 0 ? initialSpaces - 1 : 0);
-                int safeBetweenSpaces = (betweenSpaces > 2 ? betweenSpaces - 2 : 0);
-                cout << string(safeInitialSpaces, ' ');
-                for (size_t i = 0; i < current.size(); i++)
-                {
-                    if (current[i] != nullptr && current[i]->left != nullptr)
-                        cout << "/";
-                    else
-                        cout << " ";
-                    cout << string(2, ' ');
-                    if (current[i] != nullptr && current[i]->right != nullptr)
-                        cout << "\\";
-                    else
-                        cout << " ";
-                    if (i < current.size() - 1)
-                        cout << string(safeBetweenSpaces, ' ');
-                }
-                cout << "\n";
+                break;
             }
-            current = next;
-            level++;
+            levels++;
+            first = deeperFirst;
+            last = deeperLast;
+        }
+        vector<string> rows;
+        layoutBalanced(levels, first, &rows, first, last);
+        for (size_t i = 0; i < rows.size(); i++)
+        {
+            cout << rows[i] << "\n";
+        }
+        if (levels < height || last - first > displayMaxWidth)
+        {
+            cout << "(Showing " << levels << " of " << height << " levels within " << displayMaxWidth
+                 << " columns; the level order display lists every node.)\n";
         }
     }
 
@@ -218,26 +707,26 @@ private:
             cout << "Tree is empty.\n";
             return;
         }
-        queue<pair<BSTNode*, int>> q;
-        q.push({ root, 1 });
-        int currentLevel = 1;
-        cout << "Level " << currentLevel << ": ";
-        while (!q.empty())
+        // walk doubles as the queue: every node is appended once, and the
+        // nodes of one level occupy [head, levelEnd).
+        walk.clear();
+        walk.push_back(root);
+        size_t head = 0;
+        int level = 1;
+        while (head < walk.size())
         {
-            auto p = q.front();
-            q.pop();
-            BSTNode* node = p.first;
-            int level = p.second;
-            if (level != currentLevel)
+            cout << (level == 1 ? "" : "\n") << "Level " << level << ": ";
+            size_t levelEnd = walk.size();
+            for (; head < levelEnd; head++)
             {
-                cout << "\nLevel " << level << ": ";
-                currentLevel = level;
+                BSTNode* node = walk[head];
+                cout << node->data << " ";
+                if (node->left)
+                    walk.push_back(node->left);
+                if (node->right)
+                    walk.push_back(node->right);
             }
-            cout << node->data << " ";
-            if (node->left)
-                q.push({ node->left, level + 1 });
-            if (node->right)
-                q.push({ node->right, level + 1 });
+            level++;
         }
         cout << "\n";
     }
@@ -251,531 +740,2915 @@ private:
     }
 
 public:
-    BST(bool allowDuplicates = true) : root(nullptr), allowDuplicates(allowDuplicates) {}
+    static const int kDefaultDisplayDepth = 32;
+    static const int kDefaultDisplayWidth = 1024;
 
-    void insert(int value)
+    BST(bool allowDuplicates = true)
+        : root(nullptr), maxNode(nullptr), maxLevel(0), allowDuplicates(allowDuplicates),
+          displayMaxDepth(kDefaultDisplayDepth), displayMaxWidth(kDefaultDisplayWidth), frozen(false) {}
+
+    void setDisplayLimits(int maxDepth, int maxWidth)
     {
-        root = insertRecursive(root, value);
+        TREES_PROFILE_SCOPE("BST::setDisplayLimits");
+        displayMaxDepth = max(1, min(maxDepth, 62));
+        displayMaxWidth = max(1, maxWidth);
     }
 
-    void remove(int value)
+    void insert(int value)
     {
-        bool found = false;
-        root = deleteRecursive(root, value, found);
-        if (!found)
+        TREES_PROFILE_SCOPE("BST::insert");
+        BSTNode* added = insertIterative(value);
+        if (added == nullptr)
         {
-            cout << "Value " << value << " not found in the tree.\n";
+            return;
+        }
+        // Equal values go right, so anything >= the maximum lands at the end
+        // of the right spine.
+        if (maxNode == nullptr || value >= maxNode->data)
+        {
+            maxNode = added;
+            maxLevel++;
+        }
+        if (frozen && ++frozenDelta[value] == 0)
+        {
+            frozenDelta.erase(value);
         }
     }
 
-    void display()
-    {
-        cout << "\nBinary Search Tree Visual Representation:\n";
-        displayBoth();
-    }
-
-    void levelOrderTraversal()
+    void remove(int value)
     {
-        vector<int> levels;
-        if (root == nullptr)
+        TREES_PROFILE_SCOPE("BST::remove");
+        bool mayTouchSpine = root != nullptr && value >= root->data;
+        if (!deleteIterative(value))
         {
-            cout << "Tree is empty.\n";
+            cout << "Value " << value << " not found in the tree.\n";
             return;
         }
-        queue<BSTNode*> q;
-        q.push(root);
-        while (!q.empty())
+        // Only right-spine nodes can move the maximum, and they all hold
+        // values >= the root's.
+        if (mayTouchSpine)
         {
-            BSTNode* curr = q.front();
-            q.pop();
-            levels.push_back(curr->data);
-            if (curr->left != nullptr)
+            findMax();
+        }
+        if (frozen && --frozenDelta[value] == 0)
+        {
+            frozenDelta.erase(value);
+        }
+    }
+
+    // Replaces the contents with values in O(n) after an O(n) radix sort:
+    // duplicates are dropped unless allowed, and the nodes are created level
+    // by level into one contiguous run. Each range is split at the first copy
+    // of its middle key, so equal keys stay in the right subtree as insert()
+    // puts them; without duplicates the result is perfectly balanced.
+    void buildFrom(vector<int> values)
+    {
+        TREES_PROFILE_SCOPE("BST::buildFrom");
+        nodes.clear();
+        root = nullptr;
+        radixSort(values);
+        if (!allowDuplicates)
+        {
+            values.erase(unique(values.begin(), values.end()), values.end());
+        }
+        size_t n = values.size();
+        nodes.reserve(n);
+        struct Range
+        {
+            size_t low;
+            size_t high;
+            BSTNode** link;
+        };
+        queue<Range> pending;
+        walk.clear();
+        if (n > 0)
+        {
+            Range whole = { 0, n, &root };
+            pending.push(whole);
+        }
+        while (!pending.empty())
+        {
+            Range range = pending.front();
+            pending.pop();
+            size_t middle = range.low + (range.high - range.low) / 2;
+            size_t split = lower_bound(values.begin() + range.low, values.begin() + middle, values[middle])
+                - values.begin();
+            BSTNode* node = nodes.create(values[split]);
+            walk.push_back(node);
+            node->size = range.high - range.low;
+            *range.link = node;
+            if (range.low < split)
             {
-                q.push(curr->left);
+                Range left = { range.low, split, &node->left };
+                pending.push(left);
             }
-            if (curr->right != nullptr)
+            if (split + 1 < range.high)
             {
-                q.push(curr->right);
+                Range right = { split + 1, range.high, &node->right };
+                pending.push(right);
             }
         }
-        cout << "\nLevel Order Traversal: [";
-        for (size_t i = 0; i < levels.size(); i++)
+        // walk holds the nodes in level order, which puts every child after
+        // its parent, so a backward sweep sees both children before the node
+        // itself.
+        for (size_t i = walk.size(); i-- > 0;)
         {
-            cout << levels[i];
-            if (i != levels.size() - 1)
-            {
-                cout << ", ";
-            }
+            updateNode(walk[i]);
+        }
+        findMax();
+        if (frozen)
+        {
+            freeze();
         }
-        cout << "]\n";
     }
 
-    int levelOfMax()
+    // Copies the nodes into a fresh pool in level order, one contiguous run,
+    // so that level-order walks read memory front to back; the old pool and
+    // any slots freed by remove() are released in bulk.
+    void compact()
     {
-        if (root == nullptr)
+        TREES_PROFILE_SCOPE("BST::compact");
+        NodePool<BSTNode> packed;
+        packed.reserve(size());
+        queue<pair<BSTNode*, BSTNode**>> pending;
+        if (root != nullptr)
         {
-            cout << "Tree is empty.\n";
-            return -1;
+            pending.push(make_pair(root, &root));
         }
-        int level = 1;
-        BSTNode* curr = root;
-        while (curr->right != nullptr)
+        while (!pending.empty())
         {
-            curr = curr->right;
-            level++;
+            BSTNode* node = pending.front().first;
+            BSTNode* copy = packed.create(*node);
+            *pending.front().second = copy;
+            pending.pop();
+            if (node->left != nullptr)
+                pending.push(make_pair(node->left, &copy->left));
+            if (node->right != nullptr)
+                pending.push(make_pair(node->right, &copy->right));
         }
-        return level;
+        nodes.clear();
+        nodes.splice(packed);
+        findMax();
     }
 
-    void showMaxElementAndLevel()
+    size_t size() const
     {
-        if (root == nullptr)
+        TREES_PROFILE_SCOPE("BST::size");
+        return getSize(root);
+    }
+
+    // The k-th smallest value, counting from 1, in O(height).
+    bool select(size_t k, int& value) const
+    {
+        TREES_PROFILE_SCOPE("BST::select");
+        if (k == 0 || k > size())
         {
-            cout << "Tree is empty.\n";
-            return;
+            return false;
         }
-        int level = 1;
-        BSTNode* curr = root;
-        while (curr->right != nullptr)
+        BSTNode* node = root;
+        while (true)
         {
-            curr = curr->right;
-            level++;
+            size_t leftSize = getSize(node->left);
+            if (k <= leftSize)
+            {
+                node = node->left;
+            }
+            else if (k == leftSize + 1)
+            {
+                value = node->data;
+                return true;
+            }
+            else
+            {
+                k -= leftSize + 1;
+                node = node->right;
+            }
         }
-        cout << "Maximum Element: " << curr->data << ", at Level: " << level << "\n";
     }
-};
-
-// ==================== Binary Tree Implementation ====================
+
+    // How many stored values are smaller than value, in O(height).
+    size_t rank(int value) const
+    {
+        TREES_PROFILE_SCOPE("BST::rank");
+        return countBelow(value, false);
+    }
+
+    // How many stored values lie in [low, high], in O(height).
+    size_t countRange(int low, int high) const
+    {
+        TREES_PROFILE_SCOPE("BST::countRange");
+        if (low > high)
+        {
+            return 0;
+        }
+        return countBelow(high, true) - countBelow(low, false);
+    }
+
+    // Snapshots the tree for read-mostly use: contains() then searches a
+    // contiguous Eytzinger array instead of chasing node pointers. Mutations
+    // after the snapshot still update the tree and are also recorded as net
+    // per-value count changes in a small delta, which the next freeze()
+    // folds in by snapshotting again.
+    void freeze()
+    {
+        TREES_PROFILE_SCOPE("BST::freeze");
+        vector<pair<int, int>> sorted;
+        path.clear();
+        BSTNode* node = root;
+        while (node != nullptr || !path.empty())
+        {
+            while (node != nullptr)
+            {
+                path.push_back(node);
+                node = node->left;
+            }
+            node = path.back();
+            path.pop_back();
+            if (!sorted.empty() && sorted.back().first == node->data)
+                sorted.back().second++;
+            else
+                sorted.push_back(make_pair(node->data, 1));
+            node = node->right;
+        }
+        frozenKeys.assign(sorted.size() + 1, 0);
+        frozenCounts.assign(sorted.size() + 1, 0);
+        fillEytzinger(sorted, 0, 1);
+        frozenDelta.clear();
+        frozen = true;
+    }
+
+    bool isFrozen() const
+    {
+        TREES_PROFILE_SCOPE("BST::isFrozen");
+        return frozen;
+    }
+
+    // Number of values changed since the last freeze().
+    size_t pendingChanges() const
+    {
+        TREES_PROFILE_SCOPE("BST::pendingChanges");
+        return frozenDelta.size();
+    }
+
+    bool contains(int value) const
+    {
+        TREES_PROFILE_SCOPE("BST::contains");
+        if (!frozen)
+        {
+            BSTNode* node = root;
+            while (node != nullptr && node->data != value)
+            {
+                node = value < node->data ? node->left : node->right;
+            }
+            return node != nullptr;
+        }
+        size_t slot = frozenLowerBound(value);
+        int count = slot != 0 && frozenKeys[slot] == value ? frozenCounts[slot] : 0;
+        if (!frozenDelta.empty())
+        {
+            unordered_map<int, int>::const_iterator change = frozenDelta.find(value);
+            if (change != frozenDelta.end())
+                count += change->second;
+        }
+        return count > 0;
+    }
+
+    void display()
+    {
+        TREES_PROFILE_SCOPE("BST::display");
+        cout << "\nBinary Search Tree Visual Representation:\n";
+        displayBoth();
+    }
+
+    void levelOrderTraversal()
+    {
+        TREES_PROFILE_SCOPE("BST::levelOrderTraversal");
+        if (root == nullptr)
+        {
+            cout << "Tree is empty.\n";
+            return;
+        }
+        cout << "\nLevel Order Traversal: [";
+        walk.clear();
+        walk.push_back(root);
+        for (size_t head = 0; head < walk.size(); head++)
+        {
+            BSTNode* curr = walk[head];
+            if (head != 0)
+            {
+                cout << ", ";
+            }
+            cout << curr->data;
+            if (curr->left != nullptr)
+            {
+                walk.push_back(curr->left);
+            }
+            if (curr->right != nullptr)
+            {
+                walk.push_back(curr->right);
+            }
+        }
+        cout << "]\n";
+    }
+
+    int levelOfMax()
+    {
+        TREES_PROFILE_SCOPE("BST::levelOfMax");
+        if (root == nullptr)
+        {
+            cout << "Tree is empty.\n";
+            return -1;
+        }
+        return maxLevel;
+    }
+
+    void showMaxElementAndLevel()
+    {
+        TREES_PROFILE_SCOPE("BST::showMaxElementAndLevel");
+        if (root == nullptr)
+        {
+            cout << "Tree is empty.\n";
+            return;
+        }
+        cout << "Maximum Element: " << maxNode->data << ", at Level: " << maxLevel << "\n";
+    }
+};
+
+// ==================== Concurrent BST ====================
+
+// Epoch-based reclamation shared by every lock-free structure. A thread
+// enters an epoch for the length of each operation. Unlinked objects are
+// retired with the epoch current at that time and freed once the global
+// epoch has moved two steps past it, by which point no thread that could
+// still hold a pointer to them is inside an operation.
+class EpochReclaimer
+{
+private:
+    struct Retired
+    {
+        void* object;
+        void (*destroy)(void*);
+        unsigned long long epoch;
+    };
+
+    // One per thread, reused after the thread exits. `state` is
+    // (epoch << 1) | 1 inside an operation and 0 outside.
+    struct Participant
+    {
+        atomic<unsigned long long> state;
+        atomic<bool> inUse;
+        Participant* next;
+        int depth;
+        size_t sinceScan;
+        vector<Retired> limbo;
+        Participant() : state(0), inUse(true), next(nullptr), depth(0), sinceScan(0) {}
+    };
+
+    // Gives the participant back, and its pending objects to the orphans,
+    // when the owning thread exits.
+    struct Registration
+    {
+        Participant* participant;
+        Registration() : participant(instance().acquire()) {}
+        ~Registration() { instance().release(participant); }
+    };
+
+    static const size_t kScanInterval = 64;
+
+    atomic<unsigned long long> globalEpoch;
+    atomic<Participant*> participants;
+    mutex orphanLock;
+    vector<Retired> orphans;
+
+    EpochReclaimer() : globalEpoch(0), participants(nullptr) {}
+
+    ~EpochReclaimer()
+    {
+        for (size_t i = 0; i < orphans.size(); i++)
+        {
+            orphans[i].destroy(orphans[i].object);
+        }
+        Participant* p = participants.load();
+        while (p != nullptr)
+        {
+            Participant* next = p->next;
+            for (size_t i = 0; i < p->limbo.size(); i++)
+            {
+                p->limbo[i].destroy(p->limbo[i].object);
+            }
+            delete p;
+            p = next;
+        }
+    }
+
+    Participant* acquire()
+    {
+        for (Participant* p = participants.load(); p != nullptr; p = p->next)
+        {
+            bool idle = false;
+            if (p->inUse.compare_exchange_strong(idle, true))
+                return p;
+        }
+        Participant* p = new Participant;
+        Participant* head = participants.load();
+        do
+        {
+            p->next = head;
+        } while (!participants.compare_exchange_weak(head, p));
+        return p;
+    }
+
+    void release(Participant* p)
+    {
+        {
+            lock_guard<mutex> guard(orphanLock);
+            orphans.insert(orphans.end(), p->limbo.begin(), p->limbo.end());
+        }
+        p->limbo.clear();
+        p->inUse.store(false);
+    }
+
+    static Participant* self()
+    {
+        static thread_local Registration registration;
+        return registration.participant;
+    }
+
+    // Moves the global epoch on if every thread inside an operation has
+    // already observed the current one.
+    void tryAdvance()
+    {
+        unsigned long long epoch = globalEpoch.load();
+        for (Participant* p = participants.load(); p != nullptr; p = p->next)
+        {
+            unsigned long long state = p->state.load();
+            if ((state & 1) != 0 && (state >> 1) != epoch)
+                return;
+        }
+        globalEpoch.compare_exchange_strong(epoch, epoch + 1);
+    }
+
+    static void freeExpired(vector<Retired>& retired, unsigned long long epoch)
+    {
+        size_t kept = 0;
+        for (size_t i = 0; i < retired.size(); i++)
+        {
+            if (retired[i].epoch + 2 <= epoch)
+                retired[i].destroy(retired[i].object);
+            else
+                retired[kept++] = retired[i];
+        }
+        retired.resize(kept);
+    }
+
+public:
+    static EpochReclaimer& instance()
+    {
+        static EpochReclaimer reclaimer;
+        return reclaimer;
+    }
+
+    // Scoped critical section; nests.
+    class Guard
+    {
+    private:
+        Participant* participant;
+
+    public:
+        Guard() : participant(self())
+        {
+            if (participant->depth++ > 0)
+            {
+                return;
+            }
+            EpochReclaimer& reclaimer = instance();
+            unsigned long long epoch;
+            do
+            {
+                epoch = reclaimer.globalEpoch.load();
+                participant->state.store((epoch << 1) | 1);
+            } while (reclaimer.globalEpoch.load() != epoch);
+        }
+
+        ~Guard()
+        {
+            if (--participant->depth == 0)
+                participant->state.store(0);
+        }
+    };
+
+    // Must be called inside a Guard, after `object` has been unlinked.
+    template <typename T>
+    void retire(T* object)
+    {
+        Participant* p = self();
+        Retired retired = { object, [](void* doomed) { delete static_cast<T*>(doomed); }, globalEpoch.load() };
+        p->limbo.push_back(retired);
+        if (++p->sinceScan < kScanInterval)
+        {
+            return;
+        }
+        p->sinceScan = 0;
+        tryAdvance();
+        unsigned long long epoch = globalEpoch.load();
+        freeExpired(p->limbo, epoch);
+        if (orphanLock.try_lock())
+        {
+            lock_guard<mutex> guard(orphanLock, adopt_lock);
+            freeExpired(orphans, epoch);
+        }
+    }
+};
+
+// Lock-free external BST after Natarajan and Mittal: values live in the
+// leaves and internal nodes only route. A remove first flags the edge to its
+// leaf, then tags the edge to the leaf's sibling so that nothing can be
+// attached there, and finally swings the nearest untagged ancestor edge past
+// the whole tagged chain in one CAS. Any thread that runs into a flagged or
+// tagged edge finishes that removal before retrying its own operation, so
+// insert, remove and contains are all lock-free.
+//
+// Set semantics, like BST(false): insert returns false for a value already
+// present and remove returns false for one that is missing.
+//
+// TREES_CAS_WINDOW() runs between reading an edge and the CAS that relies on
+// it. It is empty unless defined before this file is included; check.cpp
+// makes it yield, which widens those windows so that the helping paths run.
+#ifndef TREES_CAS_WINDOW
+#define TREES_CAS_WINDOW()
+#endif
+
+class ConcurrentBST
+{
+private:
+    struct Node
+    {
+        long long key;
+        atomic<uintptr_t> left;
+        atomic<uintptr_t> right;
+        Node(long long key, Node* left = nullptr, Node* right = nullptr)
+            : key(key), left(reinterpret_cast<uintptr_t>(left)), right(reinterpret_cast<uintptr_t>(right)) {}
+    };
+
+    // Edge marks kept in the low bits of the child pointers.
+    static const uintptr_t kFlag = 1;
+    static const uintptr_t kTag = 2;
+
+    // Sentinel keys above every int, so the real tree always hangs off the
+    // left of two fixed internal nodes.
+    static const long long kInfinity0 = 1LL << 32;
+    static const long long kInfinity1 = kInfinity0 + 1;
+    static const long long kInfinity2 = kInfinity0 + 2;
+
+    struct SeekRecord
+    {
+        Node* ancestor;
+        Node* successor;
+        Node* parent;
+        Node* leaf;
+    };
+
+    Node* rootR;
+    Node* rootS;
+
+    ConcurrentBST(const ConcurrentBST&);
+    ConcurrentBST& operator=(const ConcurrentBST&);
+
+    static Node* address(uintptr_t edge)
+    {
+        return reinterpret_cast<Node*>(edge & ~(kFlag | kTag));
+    }
+
+    static uintptr_t clean(Node* node)
+    {
+        return reinterpret_cast<uintptr_t>(node);
+    }
+
+    static atomic<uintptr_t>& childToward(Node* node, long long key)
+    {
+        return key < node->key ? node->left : node->right;
+    }
+
+    // Finds the leaf on key's path, its parent, and the last untagged edge
+    // above them (ancestor -> successor), which is the one cleanup swings.
+    void seek(long long key, SeekRecord& record) const
+    {
+        record.ancestor = rootR;
+        record.successor = rootS;
+        record.parent = rootS;
+        record.leaf = address(rootS->left.load());
+        uintptr_t parentField = rootS->left.load();
+        uintptr_t currentField = record.leaf->left.load();
+        Node* current = address(currentField);
+        while (current != nullptr)
+        {
+            if ((parentField & kTag) == 0)
+            {
+                record.ancestor = record.parent;
+                record.successor = record.leaf;
+            }
+            record.parent = record.leaf;
+            record.leaf = current;
+            parentField = currentField;
+            currentField = childToward(current, key).load();
+            current = address(currentField);
+        }
+    }
+
+    // Detaches the flagged leaf below record.parent together with the
+    // tagged chain from record.successor down, and retires what it cut off.
+    bool cleanup(long long key, const SeekRecord& record)
+    {
+        Node* ancestor = record.ancestor;
+        Node* successor = record.successor;
+        Node* parent = record.parent;
+        atomic<uintptr_t>& successorEdge = childToward(ancestor, key);
+        atomic<uintptr_t>* childEdge = &childToward(parent, key);
+        atomic<uintptr_t>* siblingEdge = key < parent->key ? &parent->right : &parent->left;
+        if ((childEdge->load() & kFlag) == 0)
+        {
+            // The leaf being removed is the sibling; key's own leaf stays.
+            swap(childEdge, siblingEdge);
+        }
+        TREES_CAS_WINDOW();
+        siblingEdge->fetch_or(kTag);
+        uintptr_t sibling = siblingEdge->load();
+        uintptr_t expected = clean(successor);
+        TREES_CAS_WINDOW();
+        if (!successorEdge.compare_exchange_strong(expected, sibling & ~kTag))
+        {
+            return false;
+        }
+        EpochReclaimer& reclaimer = EpochReclaimer::instance();
+        Node* node = successor;
+        while (node != parent)
+        {
+            Node* next = address(childToward(node, key).load());
+            Node* removedLeaf = address((key < node->key ? node->right : node->left).load());
+            reclaimer.retire(removedLeaf);
+            reclaimer.retire(node);
+            node = next;
+        }
+        reclaimer.retire(address(childEdge->load()));
+        reclaimer.retire(parent);
+        return true;
+    }
+
+public:
+    ConcurrentBST()
+    {
+        rootS = new Node(kInfinity1, new Node(kInfinity0), new Node(kInfinity1));
+        rootR = new Node(kInfinity2, rootS, new Node(kInfinity2));
+    }
+
+    // Not thread-safe: every other thread must be done with the tree.
+    ~ConcurrentBST()
+    {
+        vector<Node*> pending(1, rootR);
+        while (!pending.empty())
+        {
+            Node* node = pending.back();
+            pending.pop_back();
+            if (Node* left = address(node->left.load()))
+                pending.push_back(left);
+            if (Node* right = address(node->right.load()))
+                pending.push_back(right);
+            delete node;
+        }
+    }
+
+    bool contains(int value) const
+    {
+        EpochReclaimer::Guard guard;
+        SeekRecord record;
+        seek(value, record);
+        return record.leaf->key == value;
+    }
+
+    bool insert(int value)
+    {
+        EpochReclaimer::Guard guard;
+        long long key = value;
+        Node* newLeaf = new Node(key);
+        Node* newInternal = new Node(0);
+        SeekRecord record;
+        while (true)
+        {
+            seek(key, record);
+            Node* leaf = record.leaf;
+            if (leaf->key == key)
+            {
+                delete newLeaf;
+                delete newInternal;
+                return false;
+            }
+            Node* parent = record.parent;
+            atomic<uintptr_t>& childEdge = childToward(parent, key);
+            newInternal->key = max(key, leaf->key);
+            newInternal->left.store(clean(key < leaf->key ? newLeaf : leaf));
+            newInternal->right.store(clean(key < leaf->key ? leaf : newLeaf));
+            uintptr_t expected = clean(leaf);
+            TREES_CAS_WINDOW();
+            if (childEdge.compare_exchange_strong(expected, clean(newInternal)))
+            {
+                return true;
+            }
+            if (address(expected) == leaf && (expected & (kFlag | kTag)) != 0)
+            {
+                cleanup(key, record);
+            }
+        }
+    }
+
+    bool remove(int value)
+    {
+        EpochReclaimer::Guard guard;
+        long long key = value;
+        bool injected = false;
+        Node* leaf = nullptr;
+        SeekRecord record;
+        while (true)
+        {
+            seek(key, record);
+            if (!injected)
+            {
+                leaf = record.leaf;
+                if (leaf->key != key)
+                {
+                    return false;
+                }
+                atomic<uintptr_t>& childEdge = childToward(record.parent, key);
+                uintptr_t expected = clean(leaf);
+                TREES_CAS_WINDOW();
+                if (childEdge.compare_exchange_strong(expected, expected | kFlag))
+                {
+                    injected = true;
+                    if (cleanup(key, record))
+                        return true;
+                }
+                else if (address(expected) == leaf && (expected & (kFlag | kTag)) != 0)
+                {
+                    cleanup(key, record);
+                }
+            }
+            else if (record.leaf != leaf || cleanup(key, record))
+            {
+                // Either another thread's cleanup already cut our leaf out,
+                // or this one did.
+                return true;
+            }
+        }
+    }
+};
+
+// ==================== Tree Canvas Renderer ====================
+
+// Draws a binary tree with each label to the right of every label that
+// precedes it in-order, so a single in-order pass fixes all columns. A node at
+// depth d is written on row 2d and its edges on row 2d + 1 of one preallocated
+// canvas, which is then streamed out row by row.
+//
+// A View supplies the Handle type and isNull/leftOf/rightOf/labelOf for it.
+template <typename View>
+void renderTreeCanvas(const View& view, typename View::Handle root)
+{
+    typedef typename View::Handle Handle;
+    struct Placement
+    {
+        int column;
+        int depth;
+        int labelStart;
+        int labelLength;
+        bool hasLeft;
+        bool hasRight;
+    };
+    vector<Placement> placements;
+    string labels;
+    vector<pair<Handle, int>> pending;
+    int column = 0;
+    int maxDepth = 0;
+    Handle node = root;
+    int depth = 0;
+    while (!view.isNull(node) || !pending.empty())
+    {
+        while (!view.isNull(node))
+        {
+            pending.push_back(make_pair(node, depth));
+            node = view.leftOf(node);
+            depth++;
+        }
+        node = pending.back().first;
+        depth = pending.back().second;
+        pending.pop_back();
+        string label = view.labelOf(node);
+        Placement placement;
+        placement.column = column;
+        placement.depth = depth;
+        placement.labelStart = labels.size();
+        placement.labelLength = label.size();
+        placement.hasLeft = !view.isNull(view.leftOf(node));
+        placement.hasRight = !view.isNull(view.rightOf(node));
+        placements.push_back(placement);
+        labels += label;
+        column += label.size();
+        maxDepth = max(maxDepth, depth);
+        node = view.rightOf(node);
+        depth++;
+    }
+    if (placements.empty())
+    {
+        return;
+    }
+    size_t width = column;
+    size_t rows = 2 * maxDepth + 1;
+    string canvas(width * rows, ' ');
+    for (size_t i = 0; i < placements.size(); i++)
+    {
+        const Placement& p = placements[i];
+        size_t labelRow = 2 * p.depth * width;
+        labels.copy(&canvas[labelRow + p.column], p.labelLength, p.labelStart);
+        if (p.hasLeft)
+        {
+            canvas[labelRow + width + p.column - 1] = '/';
+        }
+        if (p.hasRight)
+        {
+            canvas[labelRow + width + p.column + p.labelLength] = '\\';
+        }
+    }
+    for (size_t row = 0; row < rows; row++)
+    {
+        cout.write(&canvas[row * width], width);
+        cout << "\n";
+    }
+}
+
+template <typename T>
+struct LevelOrderView
+{
+    typedef size_t Handle;
+    const T* values;
+    size_t count;
+    LevelOrderView(const T* values, size_t count) : values(values), count(count) {}
+    bool isNull(Handle index) const { return index >= count; }
+    Handle leftOf(Handle index) const { return 2 * index + 1; }
+    Handle rightOf(Handle index) const { return 2 * index + 2; }
+    string labelOf(Handle index) const { return to_string(values[index]); }
+};
+
+// ==================== Binary Tree Implementation ====================
 
 class TreeNode
 {
 public:
     int value;
+    int height;
     TreeNode* left;
     TreeNode* right;
-    TreeNode(int val) : value(val), left(nullptr), right(nullptr) {}
+    TreeNode* parent;
+    TreeNode(int val) : value(val), height(1), left(nullptr), right(nullptr), parent(nullptr) {}
 };
 
 class BinaryTree
 {
 private:
+    struct InsertRecord
+    {
+        TreeNode* node;
+        int depth;
+        unsigned long long maxSlotBefore;
+    };
+
     TreeNode* root;
+    // Owns the linked layout's nodes. Inserts keep sibling heights within one
+    // of each other and removals are LIFO, so bump allocation plus the free
+    // list keep the nodes packed roughly by depth, and the destructor frees
+    // them a chunk at a time instead of walking the tree.
+    NodePool<TreeNode> nodes;
+    // Linked layout: every inserted node in insertion order. Each entry is a
+    // leaf once everything above it has been popped, so removeLast can detach
+    // it through its parent link without searching.
+    vector<InsertRecord> undoStack;
+    // Implicit layout: the level-order array, slot i has its children at 2i+1
+    // and 2i+2, and no TreeNodes are allocated.
     vector<int> insertionOrder;
+    bool implicitLayout;
+    unordered_map<int, int> valueCounts;
+    // Shape summary of the linked layout, kept current by insert/removeLast so
+    // the property checks never traverse. maxSlot is the largest level-order
+    // index in use; the tree is complete exactly when it equals size - 1.
+    int oneChildCount;
+    vector<int> leafDepthCounts;
+    int minLeafDepth;
+    int maxLeafDepth;
+    unsigned long long maxSlot;
 
-    void clear(TreeNode* node)
+    // check.cpp compares the counters against full traversals of root.
+    friend struct BinaryTreeReference;
+
+    int getHeight(TreeNode* node)
     {
-        if (node)
+        return node == nullptr ? 0 : node->height;
+    }
+
+    void updateHeight(TreeNode* node)
+    {
+        node->height = 1 + max(getHeight(node->left), getHeight(node->right));
+    }
+
+    void updateHeightsFrom(TreeNode* node)
+    {
+        while (node != nullptr)
+        {
+            int oldHeight = node->height;
+            updateHeight(node);
+            if (node->height == oldHeight)
+            {
+                break;
+            }
+            node = node->parent;
+        }
+    }
+
+    TreeNode* balancedAdd(int value, int& depth, unsigned long long& slot)
+    {
+        TreeNode* added = nodes.create(value);
+        depth = 1;
+        slot = 0;
+        if (root == nullptr)
+        {
+            root = added;
+            return added;
+        }
+        TreeNode* subtree = root;
+        while (true)
+        {
+            int leftHeight = getHeight(subtree->left);
+            int rightHeight = getHeight(subtree->right);
+            bool goLeft = leftHeight <= rightHeight;
+            TreeNode*& child = goLeft ? subtree->left : subtree->right;
+            depth++;
+            slot = 2 * slot + (goLeft ? 1 : 2);
+            if (child == nullptr)
+            {
+                child = added;
+                break;
+            }
+            subtree = child;
+        }
+        added->parent = subtree;
+        updateHeightsFrom(subtree);
+        return added;
+    }
+
+    void adjustLeafDepth(int depth, int delta)
+    {
+        if (depth >= (int)leafDepthCounts.size())
+        {
+            leafDepthCounts.resize(depth + 1, 0);
+        }
+        leafDepthCounts[depth] += delta;
+        if (delta > 0)
+        {
+            minLeafDepth = (minLeafDepth == 0) ? depth : min(minLeafDepth, depth);
+            maxLeafDepth = max(maxLeafDepth, depth);
+            return;
+        }
+        int top = leafDepthCounts.size() - 1;
+        while (minLeafDepth <= top && leafDepthCounts[minLeafDepth] == 0)
+        {
+            minLeafDepth++;
+        }
+        while (maxLeafDepth > 0 && leafDepthCounts[maxLeafDepth] == 0)
+        {
+            maxLeafDepth--;
+        }
+        if (maxLeafDepth == 0)
+        {
+            minLeafDepth = 0;
+        }
+    }
+
+    struct LinkedView
+    {
+        typedef TreeNode* Handle;
+        bool isNull(Handle node) const { return node == nullptr; }
+        Handle leftOf(Handle node) const { return node->left; }
+        Handle rightOf(Handle node) const { return node->right; }
+        string labelOf(Handle node) const { return to_string(node->value); }
+    };
+
+    void forgetValue(int value)
+    {
+        auto it = valueCounts.find(value);
+        if (--it->second == 0)
+        {
+            valueCounts.erase(it);
+        }
+    }
+
+public:
+    BinaryTree(bool implicit = false)
+        : root(nullptr), implicitLayout(implicit), oneChildCount(0), minLeafDepth(0), maxLeafDepth(0), maxSlot(0) {}
+
+    void insert(int value)
+    {
+        TREES_PROFILE_SCOPE("BinaryTree::insert");
+        if (implicitLayout)
+        {
+            insertionOrder.push_back(value);
+        }
+        else
+        {
+            InsertRecord record;
+            unsigned long long slot;
+            record.node = balancedAdd(value, record.depth, slot);
+            record.maxSlotBefore = maxSlot;
+            TreeNode* parent = record.node->parent;
+            if (parent != nullptr)
+            {
+                if (parent->left != nullptr && parent->right != nullptr)
+                {
+                    oneChildCount--;
+                }
+                else
+                {
+                    oneChildCount++;
+                    adjustLeafDepth(record.depth - 1, -1);
+                }
+            }
+            adjustLeafDepth(record.depth, 1);
+            maxSlot = undoStack.empty() ? slot : max(maxSlot, slot);
+            undoStack.push_back(record);
+        }
+        valueCounts[value]++;
+    }
+
+    bool exists(int value)
+    {
+        TREES_PROFILE_SCOPE("BinaryTree::exists");
+        return valueCounts.find(value) != valueCounts.end();
+    }
+
+    vector<bool> existsMany(const vector<int>& values)
+    {
+        TREES_PROFILE_SCOPE("BinaryTree::existsMany");
+        vector<bool> found(values.size());
+        for (size_t i = 0; i < values.size(); i++)
+        {
+            found[i] = valueCounts.find(values[i]) != valueCounts.end();
+        }
+        return found;
+    }
+
+    bool removeLast()
+    {
+        TREES_PROFILE_SCOPE("BinaryTree::removeLast");
+        if (implicitLayout)
+        {
+            if (insertionOrder.empty())
+            {
+                return false;
+            }
+            forgetValue(insertionOrder.back());
+            insertionOrder.pop_back();
+            return true;
+        }
+        if (undoStack.empty())
+        {
+            return false;
+        }
+        InsertRecord record = undoStack.back();
+        undoStack.pop_back();
+        TreeNode* last = record.node;
+        forgetValue(last->value);
+        TreeNode* parent = last->parent;
+        if (parent == nullptr)
+        {
+            root = nullptr;
+        }
+        else if (parent->left == last)
+        {
+            parent->left = nullptr;
+        }
+        else
+        {
+            parent->right = nullptr;
+        }
+        adjustLeafDepth(record.depth, -1);
+        if (parent != nullptr)
+        {
+            if (parent->left != nullptr || parent->right != nullptr)
+            {
+                oneChildCount++;
+            }
+            else
+            {
+                oneChildCount--;
+                adjustLeafDepth(record.depth - 1, 1);
+            }
+        }
+        maxSlot = record.maxSlotBefore;
+        nodes.destroy(last);
+        updateHeightsFrom(parent);
+        return true;
+    }
+
+    void display()
+    {
+        TREES_PROFILE_SCOPE("BinaryTree::display");
+        cout << "\nTree Visualization:\n";
+        if (implicitLayout)
+        {
+            renderTreeCanvas(LevelOrderView<int>(insertionOrder.data(), insertionOrder.size()), 0);
+        }
+        else
+        {
+            renderTreeCanvas(LinkedView(), root);
+        }
+    }
+
+    bool isFull()
+    {
+        TREES_PROFILE_SCOPE("BinaryTree::isFull");
+        if (implicitLayout)
+        {
+            // Only the parent of the last slot can have a single child.
+            return insertionOrder.size() % 2 == 1 || insertionOrder.empty();
+        }
+        return oneChildCount == 0;
+    }
+
+    bool isComplete()
+    {
+        TREES_PROFILE_SCOPE("BinaryTree::isComplete");
+        if (implicitLayout)
+        {
+            return true;
+        }
+        return undoStack.empty() || maxSlot == undoStack.size() - 1;
+    }
+
+    bool isPerfect()
+    {
+        TREES_PROFILE_SCOPE("BinaryTree::isPerfect");
+        if (implicitLayout)
+        {
+            size_t n = insertionOrder.size();
+            return (n & (n + 1)) == 0;
+        }
+        return oneChildCount == 0 && minLeafDepth == maxLeafDepth;
+    }
+};
+
+// ==================== Heap Implementation ====================
+
+// Picks the child that belongs nearest the root out of a full group of Arity
+// siblings; ties go to the leftmost, like a sequential scan.
+template <typename T, typename Compare, int Arity>
+struct ChildSelector
+{
+    static size_t select(const T* children, const Compare& compare)
+    {
+        size_t best = 0;
+        for (size_t i = 1; i < Arity; i++)
+        {
+            if (compare(children[i], children[best]))
+                best = i;
+        }
+        return best;
+    }
+};
+
+#ifdef TREES_HAVE_SSE2
+// SSE2 has no 32-bit min/max, so both are built from a compare and a blend.
+inline __m128i selectLanes(__m128i mask, __m128i ifSet, __m128i ifClear)
+{
+    return _mm_or_si128(_mm_and_si128(mask, ifSet), _mm_andnot_si128(mask, ifClear));
+}
+
+inline __m128i minLanes(__m128i a, __m128i b)
+{
+    return selectLanes(_mm_cmpgt_epi32(a, b), b, a);
+}
+
+inline __m128i maxLanes(__m128i a, __m128i b)
+{
+    return selectLanes(_mm_cmpgt_epi32(a, b), a, b);
+}
+
+// Reduces every lane to the extreme of all four, then reports which lanes of
+// each input group hold it.
+template <bool TakeMin>
+struct LaneReducer
+{
+    static __m128i combine(__m128i a, __m128i b) { return TakeMin ? minLanes(a, b) : maxLanes(a, b); }
+
+    static __m128i broadcast(__m128i v)
+    {
+        v = combine(v, _mm_shuffle_epi32(v, _MM_SHUFFLE(1, 0, 3, 2)));
+        return combine(v, _mm_shuffle_epi32(v, _MM_SHUFFLE(2, 3, 0, 1)));
+    }
+
+    static unsigned matches(__m128i v, __m128i extreme)
+    {
+        return _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(v, extreme)));
+    }
+
+    static size_t select4(const int* children)
+    {
+        __m128i v = _mm_load_si128(reinterpret_cast<const __m128i*>(children));
+        return lowestSetBit(matches(v, broadcast(v)));
+    }
+
+    static size_t select8(const int* children)
+    {
+        __m128i low = _mm_load_si128(reinterpret_cast<const __m128i*>(children));
+        __m128i high = _mm_load_si128(reinterpret_cast<const __m128i*>(children + 4));
+        __m128i extreme = broadcast(combine(low, high));
+        return lowestSetBit(matches(low, extreme) | (matches(high, extreme) << 4));
+    }
+};
+
+template <>
+struct ChildSelector<int, less<int>, 4>
+{
+    static size_t select(const int* children, const less<int>&) { return LaneReducer<true>::select4(children); }
+};
+
+template <>
+struct ChildSelector<int, greater<int>, 4>
+{
+    static size_t select(const int* children, const greater<int>&) { return LaneReducer<false>::select4(children); }
+};
+
+template <>
+struct ChildSelector<int, less<int>, 8>
+{
+    static size_t select(const int* children, const less<int>&) { return LaneReducer<true>::select8(children); }
+};
+
+template <>
+struct ChildSelector<int, greater<int>, 8>
+{
+    static size_t select(const int* children, const greater<int>&) { return LaneReducer<false>::select8(children); }
+};
+#endif
+
+// Chooses how to absorb a batch of `added` values appended behind `existing`
+// heap entries. A full heapify touches every entry once, while a sift-up is
+// O(1) on average for random input and only reaches log n on adversarial
+// orders, so heapifying pays off once the batch outnumbers the heap.
+inline bool preferHeapify(size_t existing, size_t added)
+{
+    return added > existing;
+}
+
+// d-ary heap over any value type. The comparator is a template argument, so
+// the sift loops inline it instead of testing a runtime flag per comparison;
+// Compare(a, b) is true when a belongs nearer the root than b.
+//
+// For Arity > 2 the first Arity - 1 slots are padding. Logical node i then
+// lives at slot i + Arity - 1 and its children start at slot Arity * (i + 1),
+// so each sibling group sits inside one cache line of the aligned buffer and
+// can be scanned with a single vector compare.
+//
+// Binary sibling pairs are too small to need the aligned allocator, so the
+// binary heap stores a plain vector and can adopt one without copying.
+template <typename T, typename Compare, int Arity = 2>
+class BasicHeap
+{
+public:
+    typedef typename conditional<(Arity > 2), vector<T, CacheAlignedAllocator<T>>, vector<T>>::type Storage;
+
+private:
+    static const size_t kPad = Arity > 2 ? Arity - 1 : 0;
+
+    Storage data;
+    Compare compare;
+
+    static void adopt(vector<T>&& values, vector<T>& storage)
+    {
+        storage = move(values);
+    }
+
+    template <typename Aligned>
+    static void adopt(vector<T>&& values, Aligned& storage)
+    {
+        storage.reserve(kPad + values.size());
+        storage.assign(kPad, T());
+        storage.insert(storage.end(), make_move_iterator(values.begin()), make_move_iterator(values.end()));
+    }
+
+    T& at(size_t index)
+    {
+        return data[index + kPad];
+    }
+
+    void heapifyUp(size_t index)
+    {
+        T moving = move(at(index));
+        while (index > 0)
+        {
+            size_t parent = (index - 1) / Arity;
+            if (!compare(moving, at(parent)))
+            {
+                break;
+            }
+            at(index) = move(at(parent));
+            index = parent;
+        }
+        at(index) = move(moving);
+    }
+
+    size_t bestChild(size_t first, size_t size)
+    {
+        if (Arity == 2)
+        {
+            return (first + 1 < size && compare(at(first + 1), at(first))) ? first + 1 : first;
+        }
+        const T* children = &at(first);
+        if (first + Arity <= size)
+        {
+            return first + ChildSelector<T, Compare, Arity>::select(children, compare);
+        }
+        size_t best = 0;
+        for (size_t i = 1; i < size - first; i++)
+        {
+            if (compare(children[i], children[best]))
+                best = i;
+        }
+        return first + best;
+    }
+
+    // Bottom-up (Floyd/Wegener) sift: the element taken out of index nearly
+    // always belongs near the bottom, so the hole first follows the best
+    // children all the way to a leaf, comparing siblings only, and the element
+    // is then sifted back up from there. That is one comparison per level on
+    // the way down plus a few on the way up, instead of two per level.
+    void heapifyDown(size_t index)
+    {
+        size_t size = this->size();
+        size_t start = index;
+        T moving = move(at(index));
+        while (true)
+        {
+            size_t first = Arity * index + 1;
+            if (first >= size)
+            {
+                break;
+            }
+            size_t selected = bestChild(first, size);
+            at(index) = move(at(selected));
+            index = selected;
+        }
+        while (index > start)
+        {
+            size_t parent = (index - 1) / Arity;
+            if (!compare(moving, at(parent)))
+            {
+                break;
+            }
+            at(index) = move(at(parent));
+            index = parent;
+        }
+        at(index) = move(moving);
+    }
+
+    void rebuildHeap()
+    {
+        size_t size = this->size();
+        if (size < 2)
+        {
+            return;
+        }
+        for (size_t i = (size - 2) / Arity + 1; i-- > 0;)
+        {
+            heapifyDown(i);
+        }
+    }
+
+public:
+    BasicHeap(const Compare& compare = Compare()) : data(kPad), compare(compare) {}
+
+    // Builds the heap from arbitrary values in O(n).
+    BasicHeap(vector<T>&& values, const Compare& compare = Compare()) : compare(compare)
+    {
+        adopt(move(values), data);
+        rebuildHeap();
+    }
+
+    void insert(const T& value)
+    {
+        data.push_back(value);
+        heapifyUp(size() - 1);
+    }
+
+    template <typename InputIt>
+    void insertBatch(InputIt first, InputIt last)
+    {
+        size_t existing = size();
+        data.insert(data.end(), first, last);
+        if (preferHeapify(existing, size() - existing))
+        {
+            rebuildHeap();
+            return;
+        }
+        for (size_t i = existing; i < size(); i++)
+        {
+            heapifyUp(i);
+        }
+    }
+
+    bool isEmpty() const
+    {
+        return data.size() == kPad;
+    }
+
+    size_t size() const
+    {
+        return data.size() - kPad;
+    }
+
+    const T& getRoot() const
+    {
+        return data[kPad];
+    }
+
+    void removeRoot()
+    {
+        at(0) = move(data.back());
+        data.pop_back();
+        if (!isEmpty())
+            heapifyDown(0);
+    }
+
+    // Overwrites the root and restores the heap with a single sift, which is
+    // half the work of removeRoot followed by insert.
+    void replaceRoot(const T& value)
+    {
+        at(0) = value;
+        heapifyDown(0);
+    }
+
+    // Takes over a buffer from release() and heapifies it in O(n).
+    void assign(Storage&& values)
+    {
+        data = move(values);
+        data.insert(data.begin(), kPad, T());
+        rebuildHeap();
+    }
+
+    Storage release()
+    {
+        Storage values;
+        values.swap(data);
+        values.erase(values.begin(), values.begin() + kPad);
+        data.resize(kPad);
+        return values;
+    }
+
+    // The nodes in level order: node i has children Arity * i + 1 onwards.
+    const T* elements() const
+    {
+        return data.data() + kPad;
+    }
+};
+
+// Double-ended heap: nodes on even levels are no greater than everything
+// below them and nodes on odd levels no smaller, so the minimum is the root
+// and the maximum one of its children. Both ends are O(1) to read and
+// O(log n) to remove.
+template <typename T, typename Compare = less<T>>
+class MinMaxHeap
+{
+private:
+    vector<T> data;
+    Compare compare;
+
+    static bool onMinLevel(size_t index)
+    {
+        int level = 0;
+        for (size_t i = index + 1; i > 1; i >>= 1)
+        {
+            level++;
+        }
+        return level % 2 == 0;
+    }
+
+    // "Ahead" means nearer the root for the kind of level being fixed.
+    bool ahead(const T& a, const T& b, bool minLevel) const
+    {
+        return minLevel ? compare(a, b) : compare(b, a);
+    }
+
+    void bubbleUp(size_t index, bool minLevel)
+    {
+        while (index > 2)
+        {
+            size_t grandparent = ((index - 1) / 2 - 1) / 2;
+            if (!ahead(data[index], data[grandparent], minLevel))
+            {
+                break;
+            }
+            swap(data[index], data[grandparent]);
+            index = grandparent;
+        }
+    }
+
+    void heapifyUp(size_t index)
+    {
+        if (index == 0)
+        {
+            return;
+        }
+        bool minLevel = onMinLevel(index);
+        size_t parent = (index - 1) / 2;
+        if (ahead(data[parent], data[index], minLevel))
+        {
+            swap(data[index], data[parent]);
+            bubbleUp(parent, !minLevel);
+        }
+        else
+        {
+            bubbleUp(index, minLevel);
+        }
+    }
+
+    void heapifyDown(size_t index)
+    {
+        bool minLevel = onMinLevel(index);
+        size_t size = data.size();
+        while (2 * index + 1 < size)
+        {
+            size_t best = 2 * index + 1;
+            size_t candidates[] = { 2 * index + 2, 4 * index + 3, 4 * index + 4, 4 * index + 5, 4 * index + 6 };
+            for (size_t i = 0; i < 5 && candidates[i] < size; i++)
+            {
+                if (ahead(data[candidates[i]], data[best], minLevel))
+                    best = candidates[i];
+            }
+            if (!ahead(data[best], data[index], minLevel))
+            {
+                break;
+            }
+            swap(data[best], data[index]);
+            if (best <= 2 * index + 2)
+            {
+                break;
+            }
+            size_t parent = (best - 1) / 2;
+            if (ahead(data[parent], data[best], minLevel))
+            {
+                swap(data[best], data[parent]);
+            }
+            index = best;
+        }
+    }
+
+    void rebuildHeap()
+    {
+        for (size_t i = data.size() / 2; i-- > 0;)
+        {
+            heapifyDown(i);
+        }
+    }
+
+    size_t maxIndex() const
+    {
+        if (data.size() < 3)
+        {
+            return data.size() - 1;
+        }
+        return compare(data[1], data[2]) ? 2 : 1;
+    }
+
+    void removeAt(size_t index)
+    {
+        data[index] = data.back();
+        data.pop_back();
+        if (index < data.size())
+            heapifyDown(index);
+    }
+
+public:
+    MinMaxHeap(const Compare& compare = Compare()) : compare(compare) {}
+
+    MinMaxHeap(vector<T>&& values, const Compare& compare = Compare()) : data(move(values)), compare(compare)
+    {
+        rebuildHeap();
+    }
+
+    void insert(const T& value)
+    {
+        data.push_back(value);
+        heapifyUp(data.size() - 1);
+    }
+
+    template <typename InputIt>
+    void insertBatch(InputIt first, InputIt last)
+    {
+        size_t existing = data.size();
+        data.insert(data.end(), first, last);
+        if (preferHeapify(existing, data.size() - existing))
+        {
+            rebuildHeap();
+            return;
+        }
+        for (size_t i = existing; i < data.size(); i++)
+        {
+            heapifyUp(i);
+        }
+    }
+
+    bool isEmpty() const
+    {
+        return data.empty();
+    }
+
+    size_t size() const
+    {
+        return data.size();
+    }
+
+    const T& getMin() const
+    {
+        return data[0];
+    }
+
+    const T& getMax() const
+    {
+        return data[maxIndex()];
+    }
+
+    void removeMin()
+    {
+        removeAt(0);
+    }
+
+    void removeMax()
+    {
+        removeAt(maxIndex());
+    }
+
+    const T* elements() const
+    {
+        return data.data();
+    }
+};
+
+// Addressable binary heap: insert hands back a handle that stays valid until
+// the value is removed, and update/erase reach the value through it in
+// O(log n). Each slot stores its handle next to the value, and every move in
+// the sifts also rewrites that handle's entry in `position`, so a handle
+// always knows which slot holds its value.
+template <typename T, typename Compare = less<T>>
+class IndexedHeap
+{
+public:
+    typedef size_t Handle;
+
+private:
+    struct Slot
+    {
+        T value;
+        Handle handle;
+    };
+
+    static const size_t kAbsent = static_cast<size_t>(-1);
+
+    vector<Slot> data;
+    vector<size_t> position;
+    vector<Handle> freeHandles;
+    Compare compare;
+
+    // check.cpp verifies that position and the slots' handles agree.
+    friend struct IndexedHeapReference;
+
+    void place(size_t index, Slot&& slot)
+    {
+        position[slot.handle] = index;
+        data[index] = move(slot);
+    }
+
+    void heapifyUp(size_t index)
+    {
+        Slot moving = move(data[index]);
+        while (index > 0)
+        {
+            size_t parent = (index - 1) / 2;
+            if (!compare(moving.value, data[parent].value))
+            {
+                break;
+            }
+            place(index, move(data[parent]));
+            index = parent;
+        }
+        place(index, move(moving));
+    }
+
+    // Same bottom-up sift as BasicHeap: follow the better children down to a
+    // leaf, then sift the displaced slot back up no further than `index`.
+    void heapifyDown(size_t index)
+    {
+        size_t size = data.size();
+        size_t start = index;
+        Slot moving = move(data[index]);
+        while (2 * index + 1 < size)
+        {
+            size_t child = 2 * index + 1;
+            if (child + 1 < size && compare(data[child + 1].value, data[child].value))
+                child++;
+            place(index, move(data[child]));
+            index = child;
+        }
+        while (index > start)
+        {
+            size_t parent = (index - 1) / 2;
+            if (!compare(moving.value, data[parent].value))
+            {
+                break;
+            }
+            place(index, move(data[parent]));
+            index = parent;
+        }
+        place(index, move(moving));
+    }
+
+    void removeAt(size_t index)
+    {
+        Handle handle = data[index].handle;
+        position[handle] = kAbsent;
+        freeHandles.push_back(handle);
+        Slot last = move(data.back());
+        data.pop_back();
+        if (index == data.size())
         {
-            clear(node->left);
-            clear(node->right);
-            delete node;
+            return;
+        }
+        bool rises = index > 0 && compare(last.value, data[(index - 1) / 2].value);
+        place(index, move(last));
+        if (rises)
+            heapifyUp(index);
+        else
+            heapifyDown(index);
+    }
+
+public:
+    IndexedHeap(const Compare& compare = Compare()) : compare(compare) {}
+
+    // Handles of removed values are recycled by later inserts.
+    Handle insert(const T& value)
+    {
+        Handle handle;
+        if (freeHandles.empty())
+        {
+            handle = position.size();
+            position.push_back(kAbsent);
+        }
+        else
+        {
+            handle = freeHandles.back();
+            freeHandles.pop_back();
+        }
+        Slot slot = { value, handle };
+        data.push_back(move(slot));
+        heapifyUp(data.size() - 1);
+        return handle;
+    }
+
+    bool contains(Handle handle) const
+    {
+        return handle < position.size() && position[handle] != kAbsent;
+    }
+
+    const T& get(Handle handle) const
+    {
+        return data[position[handle]].value;
+    }
+
+    // Works in both directions, so it covers decrease-key and increase-key.
+    void update(Handle handle, const T& value)
+    {
+        size_t index = position[handle];
+        bool rises = compare(value, data[index].value);
+        data[index].value = value;
+        if (rises)
+            heapifyUp(index);
+        else
+            heapifyDown(index);
+    }
+
+    void erase(Handle handle)
+    {
+        removeAt(position[handle]);
+    }
+
+    bool isEmpty() const
+    {
+        return data.empty();
+    }
+
+    size_t size() const
+    {
+        return data.size();
+    }
+
+    const T& getRoot() const
+    {
+        return data[0].value;
+    }
+
+    Handle rootHandle() const
+    {
+        return data[0].handle;
+    }
+
+    void removeRoot()
+    {
+        removeAt(0);
+    }
+};
+
+template <typename T, typename Compare>
+const size_t IndexedHeap<T, Compare>::kAbsent;
+
+// Meldable heap: every node keeps its children in a singly linked list, so
+// insert and merge are a single comparison and link, and removeRoot pairs up
+// the orphaned children left to right, then melds the pairs right to left
+// (amortized O(log n)). Nodes live in a NodePool and merge() splices the
+// pools, so merging never copies or re-inserts values.
+template <typename T, typename Compare = less<T>>
+class PairingHeap
+{
+private:
+    struct Node
+    {
+        T value;
+        Node* child;
+        Node* sibling;
+        Node(const T& value) : value(value), child(nullptr), sibling(nullptr) {}
+    };
+
+    static const int kDisplayIndentLimit = 32;
+
+    Node* root;
+    size_t count;
+    NodePool<Node> pool;
+    Compare compare;
+
+    PairingHeap(const PairingHeap&);
+    PairingHeap& operator=(const PairingHeap&);
+
+    // Both arguments must be roots without siblings.
+    Node* meld(Node* a, Node* b)
+    {
+        if (a == nullptr)
+            return b;
+        if (b == nullptr)
+            return a;
+        if (compare(b->value, a->value))
+            swap(a, b);
+        b->sibling = a->child;
+        a->child = b;
+        return a;
+    }
+
+    // Hands each value to `visit` and frees its node, without recursion: each
+    // node's child list is spliced in front of the pending list, so every
+    // sibling chain is walked once.
+    template <typename Visit>
+    void drain(Visit visit)
+    {
+        Node* pending = root;
+        while (pending != nullptr)
+        {
+            Node* node = pending;
+            pending = node->sibling;
+            if (node->child != nullptr)
+            {
+                Node* last = node->child;
+                while (last->sibling != nullptr)
+                {
+                    last = last->sibling;
+                }
+                last->sibling = pending;
+                pending = node->child;
+            }
+            visit(node->value);
+            pool.destroy(node);
+        }
+        root = nullptr;
+        count = 0;
+    }
+
+public:
+    PairingHeap(const Compare& compare = Compare()) : root(nullptr), count(0), compare(compare) {}
+
+    ~PairingHeap()
+    {
+        drain([](const T&) {});
+    }
+
+    void insert(const T& value)
+    {
+        root = meld(root, pool.create(value));
+        count++;
+    }
+
+    template <typename InputIt>
+    void insertBatch(InputIt first, InputIt last)
+    {
+        for (; first != last; ++first)
+        {
+            insert(*first);
+        }
+    }
+
+    // Moves every node of `other` into this heap in O(1); `other` is left
+    // empty. Both heaps must order their values the same way.
+    void merge(PairingHeap& other)
+    {
+        if (&other == this)
+        {
+            return;
+        }
+        root = meld(root, other.root);
+        count += other.count;
+        pool.splice(other.pool);
+        other.root = nullptr;
+        other.count = 0;
+    }
+
+    bool isEmpty() const
+    {
+        return root == nullptr;
+    }
+
+    size_t size() const
+    {
+        return count;
+    }
+
+    const T& getRoot() const
+    {
+        return root->value;
+    }
+
+    void removeRoot()
+    {
+        Node* oldRoot = root;
+        Node* pending = oldRoot->child;
+        Node* paired = nullptr;
+        while (pending != nullptr)
+        {
+            Node* first = pending;
+            Node* second = first->sibling;
+            if (second == nullptr)
+            {
+                first->sibling = paired;
+                paired = first;
+                break;
+            }
+            pending = second->sibling;
+            first->sibling = second->sibling = nullptr;
+            Node* pair = meld(first, second);
+            pair->sibling = paired;
+            paired = pair;
+        }
+        Node* result = nullptr;
+        while (paired != nullptr)
+        {
+            Node* next = paired->sibling;
+            paired->sibling = nullptr;
+            result = meld(result, paired);
+            paired = next;
+        }
+        root = result;
+        count--;
+        pool.destroy(oldRoot);
+    }
+
+    // Hands out every value in no particular order and empties the heap.
+    vector<T> release()
+    {
+        vector<T> values;
+        values.reserve(count);
+        drain([&values](const T& value) { values.push_back(value); });
+        return values;
+    }
+
+    // Lists the heap as an outline: every node on its own line, indented
+    // under its parent, with children in sibling order. A drawn tree would
+    // be as wide as the node count and as deep as the longest sibling chain,
+    // which sorted inserts make n long. Indentation stops growing after
+    // kDisplayIndentLimit levels and deeper lines show their depth instead,
+    // so the output stays linear in the node count.
+    void display() const
+    {
+        vector<pair<const Node*, int>> pending;
+        if (root != nullptr)
+        {
+            pending.push_back(make_pair(root, 0));
+        }
+        string line;
+        while (!pending.empty())
+        {
+            const Node* node = pending.back().first;
+            int depth = pending.back().second;
+            pending.pop_back();
+            line.assign(2 * (depth < kDisplayIndentLimit ? depth : kDisplayIndentLimit), ' ');
+            if (depth > kDisplayIndentLimit)
+            {
+                line += "[depth " + to_string(depth) + "] ";
+            }
+            line += to_string(node->value);
+            cout << line << "\n";
+            if (node->sibling != nullptr)
+            {
+                pending.push_back(make_pair(node->sibling, depth));
+            }
+            if (node->child != nullptr)
+            {
+                pending.push_back(make_pair(node->child, depth + 1));
+            }
+        }
+    }
+};
+
+// Priority queue for more values than fit in memory. memoryLimit bounds every
+// value the heap holds in memory: half of it goes to an in-memory BasicHeap
+// that takes new values, the rest to the read blocks of the runs on disk.
+// When the in-memory heap is full its contents are sorted and written out as
+// one run to a tmpfile(). The root is the better of the in-memory root and
+// the best run head, and the run heads are kept in a small heap of their
+// own, so every removal is a k-way merge step.
+//
+// Each open run, and the block a merge writes through, gets an equal share
+// of the read budget, at most blockBytes. A newly opened run shrinks the
+// share; runs holding bigger blocks hand their unread values back to the
+// file and reread them in smaller blocks. Reads and writes still move whole
+// blocks, so disk access stays sequential. Every run keeps at least one
+// value buffered, so a limit below two values per open run is exceeded by
+// that minimum.
+//
+// Runs are tiered like the levels of an LSM tree: once kMergeFanIn runs share
+// a level they are merged into one run on the next level. That caps the
+// number of open runs at kMergeFanIn - 1 per level while every value is
+// rewritten only O(log n) times. Slots of finished runs are reused.
+//
+// Values must be trivially copyable since they are written out byte for byte.
+// insert() returns false, and drops the value, when the in-memory heap is
+// full and cannot be spilled because a run file cannot be created or
+// written. A failed read ends that run early. failed() reports either.
+template <typename T, typename Compare = less<T>>
+class ExternalHeap
+{
+private:
+    struct Run
+    {
+        FILE* file;
+        size_t unread;
+        vector<T> block;
+        size_t next;
+        size_t level;
+    };
+
+    struct RunHead
+    {
+        T value;
+        size_t run;
+    };
+
+    struct HeadCompare
+    {
+        Compare compare;
+        HeadCompare(const Compare& compare) : compare(compare) {}
+        bool operator()(const RunHead& a, const RunHead& b) const { return compare(a.value, b.value); }
+    };
+
+    typedef BasicHeap<RunHead, HeadCompare> HeadHeap;
+
+    static const size_t kMergeFanIn = 16;
+
+    BasicHeap<T, Compare> memory;
+    vector<Run> runs;
+    vector<size_t> freeRuns;
+    vector<size_t> liveRuns;
+    size_t openRuns;
+    HeadHeap heads;
+    size_t memoryLimit;
+    size_t heapLimit;
+    size_t blockValues;
+    size_t spilled;
+    bool ioFailed;
+    Compare compare;
+
+    ExternalHeap(const ExternalHeap&);
+    ExternalHeap& operator=(const ExternalHeap&);
+
+    static FILE* createFile()
+    {
+        FILE* file = tmpfile();
+        if (file != nullptr)
+            setvbuf(file, nullptr, _IONBF, 0);
+        return file;
+    }
+
+    // Values each open run may hold in memory, its head included. One more
+    // share is kept back for the block a merge writes through.
+    size_t bufferShare() const
+    {
+        size_t share = (memoryLimit - heapLimit) / (openRuns + 1);
+        return max<size_t>(min(share, blockValues), 1);
+    }
+
+    size_t readBlockValues() const
+    {
+        size_t share = bufferShare();
+        return share > 1 ? share - 1 : 1;
+    }
+
+    // Moves the next value of run `index` into `target`, refilling the run's
+    // block from disk when it is used up, or closes the run at its end.
+    void advance(size_t index, HeadHeap& target)
+    {
+        Run& run = runs[index];
+        if (run.next == run.block.size())
+        {
+            size_t blockLimit = readBlockValues();
+            size_t wanted = min(blockLimit, run.unread);
+            if (run.block.capacity() > blockLimit)
+                vector<T>().swap(run.block);
+            run.block.resize(wanted);
+            size_t got = wanted == 0 ? 0 : fread(run.block.data(), sizeof(T), wanted, run.file);
+            if (got < wanted)
+            {
+                ioFailed = true;
+                run.block.resize(got);
+                run.unread = got;
+            }
+            run.unread -= got;
+            run.next = 0;
+            if (got == 0)
+            {
+                fclose(run.file);
+                run.file = nullptr;
+                vector<T>().swap(run.block);
+                liveRuns[run.level]--;
+                openRuns--;
+                freeRuns.push_back(index);
+                return;
+            }
+        }
+        RunHead head = { run.block[run.next++], index };
+        target.insert(head);
+    }
+
+    // Hands the unread part of every block larger than the current share back
+    // to its file; those runs reread it in smaller blocks on their next refill.
+    void shrinkBlocks()
+    {
+        size_t blockLimit = readBlockValues();
+        for (size_t i = 0; i < runs.size(); i++)
+        {
+            Run& run = runs[i];
+            if (run.file == nullptr || run.block.capacity() <= blockLimit)
+                continue;
+            size_t remaining = run.block.size() - run.next;
+            if (remaining > 0 && fseek(run.file, -static_cast<long>(remaining * sizeof(T)), SEEK_CUR) != 0)
+            {
+                ioFailed = true;
+                continue;
+            }
+            run.unread += remaining;
+            vector<T>().swap(run.block);
+            run.next = 0;
+        }
+    }
+
+    void addRun(FILE* file, size_t count, size_t level)
+    {
+        rewind(file);
+        Run run = { file, count, vector<T>(), 0, level };
+        size_t index = runs.size();
+        if (freeRuns.empty())
+        {
+            runs.push_back(move(run));
+        }
+        else
+        {
+            index = freeRuns.back();
+            freeRuns.pop_back();
+            runs[index] = move(run);
+        }
+        if (liveRuns.size() <= level)
+            liveRuns.resize(level + 1);
+        liveRuns[level]++;
+        openRuns++;
+        shrinkBlocks();
+        advance(index, heads);
+    }
+
+    // Streams every run on `level` through a k-way merge into one new run on
+    // the level above. Their current heads are pulled out of `heads` first.
+    void mergeLevel(size_t level)
+    {
+        FILE* file = createFile();
+        if (file == nullptr)
+        {
+            ioFailed = true;
+            return;
+        }
+        vector<RunHead> kept = heads.release();
+        vector<RunHead> merging;
+        for (size_t i = 0; i < kept.size();)
+        {
+            if (runs[kept[i].run].level == level)
+            {
+                merging.push_back(kept[i]);
+                kept[i] = kept.back();
+                kept.pop_back();
+            }
+            else
+                i++;
+        }
+        heads.assign(move(kept));
+        HeadHeap pending(move(merging), HeadCompare(compare));
+        size_t writeValues = bufferShare();
+        vector<T> block;
+        block.reserve(writeValues);
+        size_t written = 0;
+        while (!pending.isEmpty())
+        {
+            size_t run = pending.getRoot().run;
+            block.push_back(pending.getRoot().value);
+            pending.removeRoot();
+            advance(run, pending);
+            if (block.size() == writeValues || pending.isEmpty())
+            {
+                size_t count = fwrite(block.data(), sizeof(T), block.size(), file);
+                if (count != block.size())
+                    ioFailed = true;
+                written += count;
+                block.clear();
+            }
+        }
+        addRun(file, written, level + 1);
+    }
+
+    // Writes the in-memory heap out as a run, or leaves it in place and
+    // returns false if the run cannot be written.
+    bool spill()
+    {
+        FILE* file = createFile();
+        if (file == nullptr)
+        {
+            ioFailed = true;
+            return false;
+        }
+        vector<T> values = memory.release();
+        sort(values.begin(), values.end(), compare);
+        size_t written = 0;
+        while (written < values.size())
+        {
+            size_t count = min(blockValues, values.size() - written);
+            if (fwrite(values.data() + written, sizeof(T), count, file) != count)
+            {
+                ioFailed = true;
+                fclose(file);
+                memory.assign(move(values));
+                return false;
+            }
+            written += count;
+        }
+        spilled += written;
+        values.clear();
+        memory.assign(move(values));
+        addRun(file, written, 0);
+        for (size_t level = 0; level < liveRuns.size() && liveRuns[level] >= kMergeFanIn; level++)
+        {
+            mergeLevel(level);
+        }
+        return true;
+    }
+
+    bool runHeadFirst() const
+    {
+        if (heads.isEmpty())
+            return false;
+        return memory.isEmpty() || compare(heads.getRoot().value, memory.getRoot());
+    }
+
+public:
+    ExternalHeap(size_t memoryLimit, size_t blockBytes = 1 << 20, const Compare& compare = Compare())
+        : memory(compare), openRuns(0), heads(HeadCompare(compare)), memoryLimit(max<size_t>(memoryLimit, 1)),
+          heapLimit(max<size_t>(memoryLimit / 2, 1)), blockValues(max<size_t>(blockBytes / sizeof(T), 1)), spilled(0),
+          ioFailed(false), compare(compare)
+    {
+        static_assert(is_trivially_copyable<T>::value, "ExternalHeap writes values to disk byte for byte");
+    }
+
+    ~ExternalHeap()
+    {
+        for (size_t i = 0; i < runs.size(); i++)
+        {
+            if (runs[i].file != nullptr)
+                fclose(runs[i].file);
+        }
+    }
+
+    bool insert(const T& value)
+    {
+        if (memory.size() >= heapLimit && !spill())
+        {
+            return false;
+        }
+        memory.insert(value);
+        return true;
+    }
+
+    bool isEmpty() const
+    {
+        return memory.isEmpty() && heads.isEmpty();
+    }
+
+    // Values in memory, in unread run blocks and still on disk.
+    size_t size() const
+    {
+        size_t total = memory.size() + heads.size();
+        for (size_t i = 0; i < runs.size(); i++)
+        {
+            total += runs[i].unread + runs[i].block.size() - runs[i].next;
         }
+        return total;
     }
 
-    int getHeight(TreeNode* node)
+    // Run slots allocated so far, open or waiting to be reused.
+    size_t runSlots() const
+    {
+        return runs.size();
+    }
+
+    // Values currently buffered in memory: the in-memory heap, the run heads
+    // and the capacity of every read block.
+    size_t bufferedValues() const
+    {
+        size_t total = memory.size() + heads.size();
+        for (size_t i = 0; i < runs.size(); i++)
+        {
+            total += runs[i].block.capacity();
+        }
+        return total;
+    }
+
+    const T& getRoot() const
+    {
+        return runHeadFirst() ? heads.getRoot().value : memory.getRoot();
+    }
+
+    void removeRoot()
+    {
+        if (!runHeadFirst())
+        {
+            memory.removeRoot();
+            return;
+        }
+        size_t run = heads.getRoot().run;
+        heads.removeRoot();
+        advance(run, heads);
+    }
+
+    // How many values have been spilled from memory to disk so far.
+    size_t spilledCount() const
+    {
+        return spilled;
+    }
+
+    bool failed() const
+    {
+        return ioFailed;
+    }
+};
+
+struct MultiQueueStats
+{
+    size_t pushes;
+    size_t pops;
+    size_t lockRetries;
+    size_t emptySweeps;
+};
+
+// Relaxed concurrent priority queue: a set of BasicHeap lanes, each behind its
+// own mutex on its own cache line. push() goes to a random lane and pop()
+// takes the better root of two random lanes, so threads rarely wait on the
+// same lock at the cost of sometimes popping a value that is not the global
+// best. With c lanes per thread the expected rank of a popped value stays
+// O(c * threads). Lanes are only ever try-locked; a busy lane is skipped for
+// another random one instead of blocking.
+template <typename T, typename Compare = less<T>>
+class MultiQueue
+{
+private:
+    struct alignas(kCacheLineSize) Lane
+    {
+        mutex lock;
+        BasicHeap<T, Compare> heap;
+        size_t pushes;
+        size_t pops;
+        size_t lockRetries;
+        Lane() : pushes(0), pops(0), lockRetries(0) {}
+    };
+
+    vector<Lane, CacheAlignedAllocator<Lane>> lanes;
+    Compare compare;
+    atomic<size_t> emptySweeps;
+
+    MultiQueue(const MultiQueue&);
+    MultiQueue& operator=(const MultiQueue&);
+
+    // xorshift64* with one stream per thread.
+    static size_t randomIndex(size_t n)
     {
-        if (node == nullptr)
-            return 0;
-        {
-            return 1 + max(getHeight(node->left), getHeight(node->right));
-        }
+        static atomic<unsigned long long> nextSeed(0x9E3779B97F4A7C15ULL);
+        thread_local unsigned long long state = nextSeed.fetch_add(0x9E3779B97F4A7C15ULL);
+        state ^= state >> 12;
+        state ^= state << 25;
+        state ^= state >> 27;
+        return size_t((state * 0x2545F4914F6CDD1DULL) >> 32) % n;
     }
 
-    TreeNode* balancedAdd(TreeNode* subtree, int value)
+    // A lane holder may have been descheduled, so after a run of misses the
+    // thread gives up its time slice rather than spinning through it.
+    void backOff(size_t retries) const
     {
-        if (subtree == nullptr)
-        {
-            return new TreeNode(value);
-        }
-        int leftHeight = getHeight(subtree->left);
-        int rightHeight = getHeight(subtree->right);
-        if (leftHeight <= rightHeight)
-        {
-            subtree->left = balancedAdd(subtree->left, value);
-        }
-        else
-        {
-            subtree->right = balancedAdd(subtree->right, value);
-        }
-        return subtree;
+        if (retries % lanes.size() == 0)
+            this_thread::yield();
     }
 
-    TreeNode* removeNode(TreeNode* node, int value, bool& removed)
+    static void take(Lane& lane, T& out, size_t retries)
     {
-        if (node == nullptr)
-        {
-            return nullptr;
-        }
-        if (node->value == value && node->left == nullptr && node->right == nullptr)
-        {
-            removed = true;
-            delete node;
-            return nullptr;
-        }
-        node->left = removeNode(node->left, value, removed);
-        if (!removed)
-        {
-            node->right = removeNode(node->right, value, removed);
-        }
-        return node;
+        out = lane.heap.getRoot();
+        lane.heap.removeRoot();
+        lane.pops++;
+        lane.lockRetries += retries;
     }
 
-    vector<string> buildTreeString(TreeNode* node)
+public:
+    // Around two lanes per thread is the usual trade between contention and
+    // ordering quality.
+    explicit MultiQueue(size_t laneCount, const Compare& compare = Compare())
+        : lanes(max<size_t>(laneCount, 1)), compare(compare), emptySweeps(0) {}
+
+    void push(const T& value)
     {
-        vector<string> result;
-        if (node == nullptr)
-        {
-            return result;
-        }
-        string nodeStr = to_string(node->value);
-        vector<string> leftLines = buildTreeString(node->left);
-        vector<string> rightLines = buildTreeString(node->right);
-        int leftWidth = leftLines.empty() ? 0 : leftLines[0].size();
-        int rightWidth = rightLines.empty() ? 0 : rightLines[0].size();
-        string firstLine = string(leftWidth, ' ') + nodeStr + string(rightWidth, ' ');
-        string secondLine;
-        if (node->left)
-        {
-            secondLine += string(max(0, leftWidth - 1), ' ') + "/";
-        }
-        else
-        {
-            secondLine += string(leftWidth, ' ');
-        }
-        secondLine += string(nodeStr.size(), ' ');
-        if (node->right)
-        {
-            secondLine += "\\" + string(max(0, rightWidth - 1), ' ');
-        }
-        else
-        {
-            secondLine += string(rightWidth, ' ');
-        }
-        int maxSubLines = max(leftLines.size(), rightLines.size());
-        vector<string> mergedSubLines;
-        for (int i = 0; i < maxSubLines; i++)
-        {
-            string leftLine = (i < leftLines.size()) ? leftLines[i] : string(leftWidth, ' ');
-            string rightLine = (i < rightLines.size()) ? rightLines[i] : string(rightWidth, ' ');
-            mergedSubLines.push_back(leftLine + string(nodeStr.size(), ' ') + rightLine);
-        }
-        result.push_back(firstLine);
-        if (node->left || node->right)
+        size_t retries = 0;
+        while (true)
         {
-            result.push_back(secondLine);
+            Lane& lane = lanes[randomIndex(lanes.size())];
+            if (!lane.lock.try_lock())
+            {
+                backOff(++retries);
+                continue;
+            }
+            lock_guard<mutex> guard(lane.lock, adopt_lock);
+            lane.heap.insert(value);
+            lane.pushes++;
+            lane.lockRetries += retries;
+            return;
         }
-        result.insert(result.end(), mergedSubLines.begin(), mergedSubLines.end());
-        return result;
     }
 
-    bool isFullHelper(TreeNode* node)
+    // Returns false only once a sweep over every lane found them all empty.
+    bool tryPop(T& out)
     {
-        if (node == nullptr)
-        {
-            return true;
-        }
-        if (node->left == nullptr && node->right == nullptr)
-        {
+        size_t retries = 0;
+        size_t emptyProbes = 0;
+        while (emptyProbes < lanes.size())
+        {
+            Lane* first = &lanes[randomIndex(lanes.size())];
+            Lane* second = &lanes[randomIndex(lanes.size())];
+            if (first > second)
+                swap(first, second);
+            if (!first->lock.try_lock())
+            {
+                backOff(++retries);
+                continue;
+            }
+            lock_guard<mutex> firstGuard(first->lock, adopt_lock);
+            if (second == first)
+            {
+                if (first->heap.isEmpty())
+                {
+                    emptyProbes++;
+                    continue;
+                }
+                take(*first, out, retries);
+                return true;
+            }
+            if (!second->lock.try_lock())
+            {
+                backOff(++retries);
+                continue;
+            }
+            lock_guard<mutex> secondGuard(second->lock, adopt_lock);
+            Lane* best = first->heap.isEmpty() ? second : first;
+            if (!second->heap.isEmpty() && compare(second->heap.getRoot(), best->heap.getRoot()))
+                best = second;
+            if (best->heap.isEmpty())
+            {
+                emptyProbes++;
+                continue;
+            }
+            take(*best, out, retries);
             return true;
         }
-        if (node->left && node->right)
+        emptySweeps++;
+        for (size_t i = 0; i < lanes.size(); i++)
         {
-            return isFullHelper(node->left) && isFullHelper(node->right);
+            lock_guard<mutex> guard(lanes[i].lock);
+            if (!lanes[i].heap.isEmpty())
+            {
+                take(lanes[i], out, retries);
+                return true;
+            }
         }
         return false;
     }
 
-    int findDepth(TreeNode* node)
+    // Exact only while no other thread is pushing or popping.
+    size_t size()
     {
-        int d = 0;
-        while (node != nullptr)
+        size_t total = 0;
+        for (size_t i = 0; i < lanes.size(); i++)
         {
-            d++;
-            node = node->left;
+            lock_guard<mutex> guard(lanes[i].lock);
+            total += lanes[i].heap.size();
         }
-        return d;
+        return total;
     }
 
-    bool isPerfectHelper(TreeNode* node, int depth, int level)
+    MultiQueueStats stats()
     {
-        if (node == nullptr)
-        {
-            return true;
-        }
-        if (node->left == nullptr && node->right == nullptr)
+        MultiQueueStats totals = { 0, 0, 0, emptySweeps.load() };
+        for (size_t i = 0; i < lanes.size(); i++)
         {
-            return (depth == level + 1);
+            lock_guard<mutex> guard(lanes[i].lock);
+            totals.pushes += lanes[i].pushes;
+            totals.pops += lanes[i].pops;
+            totals.lockRetries += lanes[i].lockRetries;
         }
-        if (node->left == nullptr || node->right == nullptr)
+        return totals;
+    }
+};
+
+// Finds the first value that would displace `threshold`, the weakest value a
+// TopK keeps, i.e. the first v with compare(threshold, v). Everything before
+// it is rejected without touching the heap.
+template <typename T, typename Compare>
+struct RejectScanner
+{
+    static size_t firstCandidate(const T* values, size_t count, const T& threshold, const Compare& compare)
+    {
+        size_t i = 0;
+        while (i < count && !compare(threshold, values[i]))
         {
-            return false;
+            i++;
         }
-        return isPerfectHelper(node->left, depth, level + 1) && isPerfectHelper(node->right, depth, level + 1);
+        return i;
     }
+};
 
-    bool existsHelper(TreeNode* node, int value)
+#ifdef TREES_HAVE_SSE2
+// Rejects eight ints per step with two compares and one movemask, and only
+// falls back to a scalar scan inside the block that holds a candidate.
+template <bool KeepLarger>
+struct IntRejectScanner
+{
+    static size_t firstCandidate(const int* values, size_t count, int threshold)
     {
-        if (node == nullptr)
-        {
-            return false;
+        __m128i limit = _mm_set1_epi32(threshold);
+        size_t i = 0;
+        for (; i + 8 <= count; i += 8)
+        {
+            __m128i low = _mm_loadu_si128(reinterpret_cast<const __m128i*>(values + i));
+            __m128i high = _mm_loadu_si128(reinterpret_cast<const __m128i*>(values + i + 4));
+            __m128i hits = KeepLarger
+                ? _mm_or_si128(_mm_cmpgt_epi32(low, limit), _mm_cmpgt_epi32(high, limit))
+                : _mm_or_si128(_mm_cmplt_epi32(low, limit), _mm_cmplt_epi32(high, limit));
+            if (_mm_movemask_epi8(hits) != 0)
+            {
+                break;
+            }
         }
-        if (node->value == value)
+        for (; i < count; i++)
         {
-            return true;
+            if (KeepLarger ? values[i] > threshold : values[i] < threshold)
+                return i;
         }
-        return existsHelper(node->left, value) || existsHelper(node->right, value);
+        return count;
     }
+};
 
-public:
-    BinaryTree() : root(nullptr) {}
-
-    ~BinaryTree()
+template <>
+struct RejectScanner<int, less<int>>
+{
+    static size_t firstCandidate(const int* values, size_t count, const int& threshold, const less<int>&)
     {
-        clear(root);
+        return IntRejectScanner<true>::firstCandidate(values, count, threshold);
     }
+};
 
-    void insert(int value)
+template <>
+struct RejectScanner<int, greater<int>>
+{
+    static size_t firstCandidate(const int* values, size_t count, const int& threshold, const greater<int>&)
     {
-        root = balancedAdd(root, value);
-        insertionOrder.push_back(value);
+        return IntRejectScanner<false>::firstCandidate(values, count, threshold);
     }
+};
+#endif
 
-    bool exists(int value)
-    {
-        return existsHelper(root, value);
-    }
+// Streaming top-k: keeps the k values that Compare ranks last (the k largest
+// with less<T>) in a size-k heap of the opposite polarity, whose root is the
+// weakest value kept. A new value only reaches the heap if it beats that
+// root, so n values cost O(n log k) time at worst and O(k) memory.
+template <typename T, typename Compare = less<T>>
+class TopK
+{
+private:
+    BasicHeap<T, Compare> heap;
+    size_t k;
+    Compare compare;
 
-    bool removeLast()
+public:
+    explicit TopK(size_t k, const Compare& compare = Compare()) : heap(compare), k(k), compare(compare) {}
+
+    void offer(const T& value)
     {
-        if (insertionOrder.empty())
-        {
-            return false;
-        }
-        int lastValue = insertionOrder.back();
-        insertionOrder.pop_back();
-        bool removed = false;
-        root = removeNode(root, lastValue, removed);
-        return removed;
+        if (heap.size() < k)
+            heap.insert(value);
+        else if (k > 0 && compare(heap.getRoot(), value))
+            heap.replaceRoot(value);
     }
 
-    void display()
+    void offerBatch(const T* values, size_t count)
     {
-        cout << "\nTree Visualization:\n";
-        vector<string> lines = buildTreeString(root);
-        for (const auto& line : lines)
+        size_t i = 0;
+        for (; i < count && heap.size() < k; i++)
         {
-            cout << line << "\n";
+            heap.insert(values[i]);
         }
-    }
-
-    bool isFull()
-    {
-        return isFullHelper(root);
-    }
-
-    bool isComplete()
-    {
-        if (root == nullptr)
+        if (k == 0)
         {
-            return true;
+            return;
         }
-        queue<TreeNode*> q;
-        q.push(root);
-        bool encounteredNull = false;
-        while (!q.empty())
+        while (i < count)
         {
-            TreeNode* cur = q.front();
-            q.pop();
-            if (cur == nullptr)
-            {
-                encounteredNull = true;
-            }
-            else
+            i += RejectScanner<T, Compare>::firstCandidate(values + i, count - i, heap.getRoot(), compare);
+            if (i == count)
             {
-                if (encounteredNull)
-                {
-                    return false;
-                }
-                q.push(cur->left);
-                q.push(cur->right);
+                break;
             }
+            heap.replaceRoot(values[i++]);
         }
-        return true;
     }
 
-    bool isPerfect()
+    size_t size() const
+    {
+        return heap.size();
+    }
+
+    // The kept values, best first.
+    vector<T> sorted() const
     {
-        int depth = findDepth(root);
-        return isPerfectHelper(root, depth, 0);
+        vector<T> values(heap.elements(), heap.elements() + heap.size());
+        Compare order = compare;
+        sort(values.begin(), values.end(), [&order](const T& a, const T& b) { return order(b, a); });
+        return values;
     }
 };
 
-// ==================== Heap Implementation ====================
+enum HeapKind
+{
+    BinaryHeapKind,
+    MinMaxHeapKind,
+    PairingHeapKind
+};
 
+// The interactive heap: min/max is chosen at runtime and dispatched to the
+// matching BasicHeap instantiation, so the comparisons themselves stay static.
+// In Min-Max mode a single MinMaxHeap serves both ends and switching the type
+// only changes which end getRoot/removeRoot use. Pairing mode keeps its nodes
+// in a PairingHeap and re-links them into the other order on a switch.
 class Heap
 {
 private:
-    vector<int> data;
+    BasicHeap<int, less<int>> minHeap;
+    BasicHeap<int, greater<int>> maxHeap;
+    MinMaxHeap<int> minMaxHeap;
+    PairingHeap<int, less<int>> minPairing;
+    PairingHeap<int, greater<int>> maxPairing;
     bool isMinHeap;
+    HeapKind kind;
+
+public:
+    Heap(bool isMin = true, HeapKind kind = BinaryHeapKind) : isMinHeap(isMin), kind(kind) {}
 
-    bool compare(int a, int b)
+    Heap(vector<int>&& values, bool isMin = true, HeapKind kind = BinaryHeapKind)
+        : isMinHeap(isMin), kind(kind)
     {
-        if (isMinHeap)
-            return a < b;
-        else
-            return a > b;
+        insertBatch(move(values));
     }
 
-    void heapifyUp(int index)
+    void insertBatch(vector<int>&& values)
     {
-        while (index > 0)
+        TREES_PROFILE_SCOPE("Heap::insertBatch");
+        if (kind == PairingHeapKind)
         {
-            int parent = (index - 1) / 2;
-            if (compare(data[index], data[parent]))
-            {
-                swap(data[index], data[parent]);
-                index = parent;
-            }
+            if (isMinHeap)
+                minPairing.insertBatch(values.begin(), values.end());
             else
-            {
-                break;
-            }
+                maxPairing.insertBatch(values.begin(), values.end());
         }
-    }
-
-    void heapifyDown(int index)
-    {
-        int size = data.size();
-        while (true)
+        else if (isEmpty())
         {
-            int left = 2 * index + 1;
-            int right = 2 * index + 2;
-            int selected = index;
-            if (left < size && compare(data[left], data[selected]))
-                selected = left;
-            if (right < size && compare(data[right], data[selected]))
-                selected = right;
-            if (selected != index)
-            {
-                swap(data[index], data[selected]);
-                index = selected;
-            }
+            if (kind == MinMaxHeapKind)
+                minMaxHeap = MinMaxHeap<int>(move(values));
+            else if (isMinHeap)
+                minHeap = BasicHeap<int, less<int>>(move(values));
             else
-            {
-                break;
-            }
+                maxHeap = BasicHeap<int, greater<int>>(move(values));
         }
+        else if (kind == MinMaxHeapKind)
+            minMaxHeap.insertBatch(values.begin(), values.end());
+        else if (isMinHeap)
+            minHeap.insertBatch(values.begin(), values.end());
+        else
+            maxHeap.insertBatch(values.begin(), values.end());
     }
 
-    void rebuildHeap()
+    void insert(int value)
     {
-        int n = data.size();
-        for (int i = n / 2 - 1; i >= 0; i--)
+        TREES_PROFILE_SCOPE("Heap::insert");
+        if (kind == MinMaxHeapKind)
+            minMaxHeap.insert(value);
+        else if (kind == PairingHeapKind)
         {
-            heapifyDown(i);
+            if (isMinHeap)
+                minPairing.insert(value);
+            else
+                maxPairing.insert(value);
         }
-    }
-
-    vector<string> buildHeapString(int index)
-    {
-        vector<string> result;
-        if (index >= data.size())
-            return result;
-        string nodeStr = to_string(data[index]);
-        vector<string> leftLines = buildHeapString(2 * index + 1);
-        vector<string> rightLines = buildHeapString(2 * index + 2);
-        int leftWidth = leftLines.empty() ? 0 : leftLines[0].size();
-        int rightWidth = rightLines.empty() ? 0 : rightLines[0].size();
-        string firstLine = string(leftWidth, ' ') + nodeStr + string(rightWidth, ' ');
-        string secondLine;
-        if (2 * index + 1 < data.size())
-            secondLine += string(max(0, leftWidth - 1), ' ') + "/";
-        else
-            secondLine += string(leftWidth, ' ');
-        secondLine += string(nodeStr.size(), ' ');
-        if (2 * index + 2 < data.size())
-            secondLine += "\\" + string(max(0, rightWidth - 1), ' ');
+        else if (isMinHeap)
+            minHeap.insert(value);
         else
-            secondLine += string(rightWidth, ' ');
-        int maxSubLines = max(leftLines.size(), rightLines.size());
-        vector<string> mergedSubLines;
-        for (int i = 0; i < maxSubLines; i++)
-        {
-            string leftLine = (i < leftLines.size()) ? leftLines[i] : string(leftWidth, ' ');
-            string rightLine = (i < rightLines.size()) ? rightLines[i] : string(rightWidth, ' ');
-            mergedSubLines.push_back(leftLine + string(nodeStr.size(), ' ') + rightLine);
-        }
-        result.push_back(firstLine);
-        if ((2 * index + 1 < data.size()) || (2 * index + 2 < data.size()))
-            result.push_back(secondLine);
-        result.insert(result.end(), mergedSubLines.begin(), mergedSubLines.end());
-        return result;
-    }
-
-public:
-    Heap(bool isMin = true) : isMinHeap(isMin) {}
-
-    void insert(int value)
-    {
-        data.push_back(value);
-        heapifyUp(data.size() - 1);
+            maxHeap.insert(value);
     }
 
     bool isEmpty()
     {
-        return data.empty();
+        TREES_PROFILE_SCOPE("Heap::isEmpty");
+        if (kind == MinMaxHeapKind)
+            return minMaxHeap.isEmpty();
+        if (kind == PairingHeapKind)
+            return isMinHeap ? minPairing.isEmpty() : maxPairing.isEmpty();
+        return isMinHeap ? minHeap.isEmpty() : maxHeap.isEmpty();
     }
 
     int getRoot()
     {
-        if (data.empty())
+        TREES_PROFILE_SCOPE("Heap::getRoot");
+        if (isEmpty())
         {
             cout << "Heap is empty.\n";
             return -1;
         }
-        return data[0];
+        if (kind == MinMaxHeapKind)
+            return isMinHeap ? minMaxHeap.getMin() : minMaxHeap.getMax();
+        if (kind == PairingHeapKind)
+            return isMinHeap ? minPairing.getRoot() : maxPairing.getRoot();
+        return isMinHeap ? minHeap.getRoot() : maxHeap.getRoot();
     }
 
     void removeRoot()
     {
-        if (data.empty())
+        TREES_PROFILE_SCOPE("Heap::removeRoot");
+        if (isEmpty())
         {
             cout << "Heap is empty.\n";
             return;
         }
-        data[0] = data.back();
-        data.pop_back();
-        if (!data.empty())
-            heapifyDown(0);
+        if (kind == MinMaxHeapKind)
+        {
+            if (isMinHeap)
+                minMaxHeap.removeMin();
+            else
+                minMaxHeap.removeMax();
+        }
+        else if (kind == PairingHeapKind)
+        {
+            if (isMinHeap)
+                minPairing.removeRoot();
+            else
+                maxPairing.removeRoot();
+        }
+        else if (isMinHeap)
+            minHeap.removeRoot();
+        else
+            maxHeap.removeRoot();
     }
 
     void switchHeapType()
     {
+        TREES_PROFILE_SCOPE("Heap::switchHeapType");
+        if (kind == BinaryHeapKind)
+        {
+            if (isMinHeap)
+                maxHeap.assign(minHeap.release());
+            else
+                minHeap.assign(maxHeap.release());
+        }
+        else if (kind == PairingHeapKind)
+        {
+            vector<int> values = isMinHeap ? minPairing.release() : maxPairing.release();
+            if (isMinHeap)
+                maxPairing.insertBatch(values.begin(), values.end());
+            else
+                minPairing.insertBatch(values.begin(), values.end());
+        }
         isMinHeap = !isMinHeap;
-        rebuildHeap();
         cout << "Heap type switched. Current type: "
             << (isMinHeap ? "MinHeap" : "MaxHeap") << "\n";
     }
 
     void display()
     {
-        if (data.empty())
+        TREES_PROFILE_SCOPE("Heap::display");
+        if (isEmpty())
         {
             cout << "Heap is empty.\n";
             return;
         }
         cout << "\nHeap Tree Visualization ("
+            << (kind == MinMaxHeapKind ? "Min-Max Heap, " : kind == PairingHeapKind ? "Pairing Heap, " : "")
             << (isMinHeap ? "MinHeap" : "MaxHeap") << "):\n";
-        vector<string> lines = buildHeapString(0);
-        for (const auto& line : lines)
+        if (kind == MinMaxHeapKind)
+            renderTreeCanvas(LevelOrderView<int>(minMaxHeap.elements(), minMaxHeap.size()), 0);
+        else if (kind == PairingHeapKind)
         {
-            cout << line << "\n";
+            cout << "(children listed under their parent)\n";
+            if (isMinHeap)
+                minPairing.display();
+            else
+                maxPairing.display();
         }
+        else if (isMinHeap)
+            renderTreeCanvas(LevelOrderView<int>(minHeap.elements(), minHeap.size()), 0);
+        else
+            renderTreeCanvas(LevelOrderView<int>(maxHeap.elements(), maxHeap.size()), 0);
     }
 };
 
 // ==================== Persistent Menu Functions ====================
 
+void showOrderStatistics(BST* bst)
+{
+    cout << "\nTree holds " << bst->size() << " values.\n";
+    cout << "1. k-th smallest element\n";
+    cout << "2. Rank of a value\n";
+    cout << "3. Count values in a range\n";
+    int choice = getValidatedInt("Enter your choice: ");
+    if (choice == 1)
+    {
+        int k = getValidatedInt("Enter k: ");
+        int value;
+        if (k > 0 && bst->select(k, value))
+        {
+            cout << "Element " << k << " in sorted order: " << value << "\n";
+        }
+        else
+        {
+            cout << "k must be between 1 and " << bst->size() << ".\n";
+        }
+    }
+    else if (choice == 2)
+    {
+        int value = getValidatedInt("Enter value: ");
+        cout << bst->rank(value) << " values are smaller than " << value << ".\n";
+    }
+    else if (choice == 3)
+    {
+        int low = getValidatedInt("Enter lower bound: ");
+        int high = getValidatedInt("Enter upper bound: ");
+        cout << bst->countRange(low, high) << " values lie in [" << low << ", " << high << "].\n";
+    }
+    else
+    {
+        cout << "Invalid choice.\n";
+    }
+}
+
 void runBST(BST* bst)
 {
     while (true)
@@ -787,7 +3660,8 @@ void runBST(BST* bst)
         cout << "3. Display (Both Formats)\n";
         cout << "4. Level Order Traversal (BFS)\n";
         cout << "5. Show Maximum Element and its Level\n";
-        cout << "6. Exit to Main Menu\n";
+        cout << "6. Order Statistics (k-th Smallest, Rank, Range Count)\n";
+        cout << "7. Exit to Main Menu\n";
         int choice = getValidatedInt("Enter your choice: ");
         if (choice == 1)
         {
@@ -818,6 +3692,11 @@ void runBST(BST* bst)
             waitForEnter();
         }
         else if (choice == 6)
+        {
+            showOrderStatistics(bst);
+            waitForEnter();
+        }
+        else if (choice == 7)
         {
             break;
         }
@@ -940,10 +3819,110 @@ void runHeap(Heap* heap)
     }
 }
 
+// ==================== Batch Commands ====================
+
+// Reads `input` 1 MiB at a time and hands every integer in it to `sink`, one
+// parsed chunk per read. Any character other than a digit ends a number, a
+// '-' right before the digits makes it negative, numbers split across two
+// reads are carried over, and numbers past the int range saturate.
+template <typename Sink>
+bool streamIntegers(FILE* input, Sink sink)
+{
+    vector<char> buffer(1 << 20);
+    vector<int> values;
+    values.reserve(buffer.size() / 2);
+    long long current = 0;
+    bool inNumber = false;
+    bool negative = false;
+    size_t got;
+    while ((got = fread(buffer.data(), 1, buffer.size(), input)) > 0)
+    {
+        for (size_t i = 0; i < got; i++)
+        {
+            char c = buffer[i];
+            if (c >= '0' && c <= '9')
+            {
+                current = min(current * 10 + (c - '0'), 1LL << 31);
+                inNumber = true;
+                continue;
+            }
+            if (inNumber)
+            {
+                values.push_back(int(negative ? -current : min(current, (1LL << 31) - 1)));
+                current = 0;
+                inNumber = false;
+            }
+            negative = c == '-';
+        }
+        sink(values.data(), values.size());
+        values.clear();
+    }
+    if (inNumber)
+    {
+        values.push_back(int(negative ? -current : min(current, (1LL << 31) - 1)));
+        sink(values.data(), values.size());
+    }
+    return !ferror(input);
+}
+
+template <typename Compare>
+bool printTopK(FILE* input, size_t k)
+{
+    TopK<int, Compare> top(k);
+    bool ok = streamIntegers(input, [&top](const int* values, size_t count) { top.offerBatch(values, count); });
+    vector<int> values = top.sorted();
+    for (size_t i = 0; i < values.size(); i++)
+    {
+        cout << values[i] << "\n";
+    }
+    return ok;
+}
+
+// bstbt --topk k [--smallest] file
+// Prints the k largest (or smallest) integers in file, best first. A file
+// name of "-" reads standard input.
+int runBatchCommand(int argc, char* argv[])
+{
+    vector<string> args(argv + 1, argv + argc);
+    bool smallest = false;
+    if (args.size() == 4 && args[2] == "--smallest")
+    {
+        smallest = true;
+        args.erase(args.begin() + 2);
+    }
+    char* end = nullptr;
+    long long k = args.size() == 3 ? strtoll(args[1].c_str(), &end, 10) : -1;
+    if (args.size() != 3 || args[0] != "--topk" || end == args[1].c_str() || *end != '\0' || k < 0)
+    {
+        cerr << "Usage: " << argv[0] << " --topk k [--smallest] file\n";
+        return 1;
+    }
+    FILE* input = args[2] == "-" ? stdin : fopen(args[2].c_str(), "rb");
+    if (input == nullptr)
+    {
+        cerr << "Cannot open input file.\n";
+        return 1;
+    }
+    bool ok = smallest ? printTopK<greater<int>>(input, k) : printTopK<less<int>>(input, k);
+    if (input != stdin)
+        fclose(input);
+    if (!ok)
+    {
+        cerr << "Error reading input file.\n";
+        return 1;
+    }
+    return 0;
+}
+
 // ==================== Main Function ====================
 
-int main()
+#ifndef TREES_NO_MAIN
+int main(int argc, char* argv[])
 {
+    if (argc > 1)
+    {
+        return runBatchCommand(argc, argv);
+    }
     BST* bst = nullptr;
     BinaryTree* btree = nullptr;
     Heap* heap = nullptr;
@@ -955,6 +3934,9 @@ int main()
         cout << "2. Binary Tree\n";
         cout << "3. Heap\n";
         cout << "4. Exit\n";
+#ifdef TREES_PROFILE
+        cout << "5. Operation Latency Stats\n";
+#endif
         int mainChoice = getValidatedInt("Enter your choice: ");
         if (mainChoice == 1)
         {
@@ -968,7 +3950,20 @@ int main()
         {
             if (btree == nullptr)
             {
-                btree = new BinaryTree();
+                int storageChoice = getValidatedInt("Select Storage (Enter 1 for Linked Nodes, 2 for Implicit Array): ");
+                if (storageChoice == 1)
+                {
+                    btree = new BinaryTree(false);
+                }
+                else if (storageChoice == 2)
+                {
+                    btree = new BinaryTree(true);
+                }
+                else
+                {
+                    cout << "Invalid choice. Defaulting to Linked Nodes.\n";
+                    btree = new BinaryTree(false);
+                }
             }
             runBinaryTree(btree);
         }
@@ -976,7 +3971,7 @@ int main()
         {
             if (heap == nullptr)
             {
-                int heapChoice = getValidatedInt("Select Heap Type (Enter 1 for MinHeap, 2 for MaxHeap): ");
+                int heapChoice = getValidatedInt("Select Heap Type (Enter 1 for MinHeap, 2 for MaxHeap, 3 for Min-Max Heap, 4 for Pairing Heap): ");
                 if (heapChoice == 1)
                 {
                     heap = new Heap(true);
@@ -985,6 +3980,14 @@ int main()
                 {
                     heap = new Heap(false);
                 }
+                else if (heapChoice == 3)
+                {
+                    heap = new Heap(true, MinMaxHeapKind);
+                }
+                else if (heapChoice == 4)
+                {
+                    heap = new Heap(true, PairingHeapKind);
+                }
                 else
                 {
                     cout << "Invalid choice. Defaulting to MinHeap.\n";
@@ -997,6 +4000,13 @@ int main()
         {
             break;
         }
+#ifdef TREES_PROFILE
+        else if (mainChoice == 5)
+        {
+            Profiler::instance().printStats(cout);
+            waitForEnter();
+        }
+#endif
         else
         {
             cout << "Invalid choice, Please try again.\n";
@@ -1007,4 +4017,5 @@ int main()
     delete btree;
     delete heap;
     return 0;
-}
\ No newline at end of file
+}
+#endif
\ No newline at end of file
@@ -0,0 +1,2301 @@
+/*
+ * check.cpp
+ * Randomized checks for the structures in bstbt.cpp and rbtree.cpp. Each
+ * one drives a structure with random operations and compares every answer
+ * against a simple reference: the traversal an O(1) shortcut replaced, the
+ * recursive version of an iterative walk, or a std container.
+ *
+ * How to Compile and Run:
+ *		g++ check.cpp -std=c++11 -O1 -g -fsanitize=address,undefined -pthread -o check
+ *		./check
+ *
+ * Prints one line per check and exits with status 1 if any of them fail.
+ * The concurrent checks are meant for a -fsanitize=thread build as well.
+ * Building with -DTREES_PROFILE adds the checks for profile.h.
+ */
+
+#define TREES_NO_MAIN
+
+#include <atomic>
+#include <thread>
+
+// While set, ConcurrentBST yields between reading an edge and the CAS that
+// relies on it, so other threads get to run inside every window.
+std::atomic<bool> yieldInCasWindows(false);
+#define TREES_CAS_WINDOW() (yieldInCasWindows.load(std::memory_order_relaxed) ? std::this_thread::yield() : (void)0)
+
+#include "bstbt.cpp"
+#include "rbtree.cpp"
+
+#include <random>
+#include <set>
+#include <sstream>
+#if defined(__unix__) || defined(__APPLE__)
+#include <pthread.h>
+#include <sys/resource.h>
+#endif
+
+// The right-spine walk BST used for its maximum before caching it.
+struct BSTReference
+{
+    static string maxElementAndLevel(const BST& tree)
+    {
+        if (tree.root == nullptr)
+        {
+            return "Tree is empty.\n";
+        }
+        int level = 1;
+        BSTNode* curr = tree.root;
+        while (curr->right != nullptr)
+        {
+            curr = curr->right;
+            level++;
+        }
+        return "Maximum Element: " + to_string(curr->data) + ", at Level: " + to_string(level) + "\n";
+    }
+
+    static int levelOfMax(const BST& tree)
+    {
+        int level = 0;
+        for (BSTNode* curr = tree.root; curr != nullptr; curr = curr->right)
+        {
+            level++;
+        }
+        return tree.root == nullptr ? -1 : level;
+    }
+
+    // Appends the subtree's values in order and recomputes its height and
+    // size, failing on the first node whose cached fields disagree or whose
+    // left subtree holds a value that is not smaller than its own.
+    static bool collect(BSTNode* node, vector<int>& values, int& height, size_t& size)
+    {
+        height = 0;
+        size = 0;
+        if (node == nullptr)
+        {
+            return true;
+        }
+        int leftHeight, rightHeight;
+        size_t leftSize, rightSize;
+        if (!collect(node->left, values, leftHeight, leftSize))
+            return false;
+        if (node->left != nullptr && values.back() >= node->data)
+            return false;
+        values.push_back(node->data);
+        if (!collect(node->right, values, rightHeight, rightSize))
+            return false;
+        height = max(leftHeight, rightHeight) + 1;
+        size = leftSize + rightSize + 1;
+        return node->height == height && node->size == size;
+    }
+
+    static BSTNode* root(const BST& tree)
+    {
+        return tree.root;
+    }
+
+    static int height(const BST& tree)
+    {
+        return tree.root == nullptr ? 0 : tree.root->height;
+    }
+};
+
+// The recursive renderer BinaryTree and Heap each had a copy of before they
+// shared renderTreeCanvas: every subtree becomes a block of lines, and a
+// node's block is its label over its two children's blocks side by side.
+struct CanvasReference
+{
+    template <typename View>
+    static vector<string> build(const View& view, typename View::Handle node)
+    {
+        vector<string> result;
+        if (view.isNull(node))
+        {
+            return result;
+        }
+        string nodeStr = view.labelOf(node);
+        bool hasLeft = !view.isNull(view.leftOf(node));
+        bool hasRight = !view.isNull(view.rightOf(node));
+        vector<string> leftLines = build(view, view.leftOf(node));
+        vector<string> rightLines = build(view, view.rightOf(node));
+        size_t leftWidth = leftLines.empty() ? 0 : leftLines[0].size();
+        size_t rightWidth = rightLines.empty() ? 0 : rightLines[0].size();
+        string firstLine = string(leftWidth, ' ') + nodeStr + string(rightWidth, ' ');
+        string secondLine;
+        if (hasLeft)
+            secondLine += string(leftWidth > 0 ? leftWidth - 1 : 0, ' ') + "/";
+        else
+            secondLine += string(leftWidth, ' ');
+        secondLine += string(nodeStr.size(), ' ');
+        if (hasRight)
+            secondLine += "\\" + string(rightWidth > 0 ? rightWidth - 1 : 0, ' ');
+        else
+            secondLine += string(rightWidth, ' ');
+        result.push_back(firstLine);
+        if (hasLeft || hasRight)
+        {
+            result.push_back(secondLine);
+        }
+        for (size_t i = 0; i < max(leftLines.size(), rightLines.size()); i++)
+        {
+            string leftLine = i < leftLines.size() ? leftLines[i] : string(leftWidth, ' ');
+            string rightLine = i < rightLines.size() ? rightLines[i] : string(rightWidth, ' ');
+            result.push_back(leftLine + string(nodeStr.size(), ' ') + rightLine);
+        }
+        return result;
+    }
+
+    template <typename View>
+    static string render(const View& view, typename View::Handle root)
+    {
+        vector<string> lines = build(view, root);
+        string text;
+        for (size_t i = 0; i < lines.size(); i++)
+        {
+            text += lines[i] + "\n";
+        }
+        return text;
+    }
+};
+
+// The traversals BinaryTree used before it kept shape counters. They walk
+// the whole linked layout on every call, so they only serve as a reference.
+struct BinaryTreeReference
+{
+    static bool isFullHelper(TreeNode* node)
+    {
+        if (node == nullptr)
+        {
+            return true;
+        }
+        if (node->left == nullptr && node->right == nullptr)
+        {
+            return true;
+        }
+        if (node->left && node->right)
+        {
+            return isFullHelper(node->left) && isFullHelper(node->right);
+        }
+        return false;
+    }
+
+    static int findDepth(TreeNode* node)
+    {
+        int d = 0;
+        while (node != nullptr)
+        {
+            d++;
+            node = node->left;
+        }
+        return d;
+    }
+
+    static bool isPerfectHelper(TreeNode* node, int depth, int level)
+    {
+        if (node == nullptr)
+        {
+            return true;
+        }
+        if (node->left == nullptr && node->right == nullptr)
+        {
+            return (depth == level + 1);
+        }
+        if (node->left == nullptr || node->right == nullptr)
+        {
+            return false;
+        }
+        return isPerfectHelper(node->left, depth, level + 1) && isPerfectHelper(node->right, depth, level + 1);
+    }
+
+    static bool isFull(const BinaryTree& tree)
+    {
+        return isFullHelper(tree.root);
+    }
+
+    static bool isComplete(const BinaryTree& tree)
+    {
+        if (tree.root == nullptr)
+        {
+            return true;
+        }
+        queue<TreeNode*> q;
+        q.push(tree.root);
+        bool encounteredNull = false;
+        while (!q.empty())
+        {
+            TreeNode* cur = q.front();
+            q.pop();
+            if (cur == nullptr)
+            {
+                encounteredNull = true;
+            }
+            else
+            {
+                if (encounteredNull)
+                {
+                    return false;
+                }
+                q.push(cur->left);
+                q.push(cur->right);
+            }
+        }
+        return true;
+    }
+
+    static bool isPerfect(const BinaryTree& tree)
+    {
+        int depth = findDepth(tree.root);
+        return isPerfectHelper(tree.root, depth, 0);
+    }
+
+    // Every value in level order: a breadth-first walk from root for the
+    // linked layout, the array itself for the implicit one.
+    static vector<int> levelOrder(const BinaryTree& tree)
+    {
+        if (tree.implicitLayout)
+        {
+            return tree.insertionOrder;
+        }
+        vector<int> values;
+        queue<TreeNode*> pending;
+        if (tree.root != nullptr)
+        {
+            pending.push(tree.root);
+        }
+        while (!pending.empty())
+        {
+            TreeNode* node = pending.front();
+            pending.pop();
+            values.push_back(node->value);
+            if (node->left != nullptr)
+                pending.push(node->left);
+            if (node->right != nullptr)
+                pending.push(node->right);
+        }
+        return values;
+    }
+
+    // What display() printed with the old renderer.
+    static string display(const BinaryTree& tree)
+    {
+        string canvas = tree.implicitLayout
+            ? CanvasReference::render(LevelOrderView<int>(tree.insertionOrder.data(), tree.insertionOrder.size()), 0)
+            : CanvasReference::render(BinaryTree::LinkedView(), tree.root);
+        return "\nTree Visualization:\n" + canvas;
+    }
+};
+
+// The recursive walks RBTree used before they followed parent links, and the
+// red-black invariants.
+struct RBTreeReference
+{
+    static const char* colorName(Node* node)
+    {
+        return node->color == BLACK ? "BLACK" : "RED";
+    }
+
+    static void printRBT(const RBTree& tree, Node* node, int depth, ostream& out)
+    {
+        if (node == tree.nil)
+            return;
+        string indent;
+        for (int i = 0; i < depth; ++i)
+            indent += ". ";
+        out << indent << node->name << " (" << colorName(node) << ")" << endl;
+        printRBT(tree, node->left, depth + 1, out);
+        printRBT(tree, node->right, depth + 1, out);
+    }
+
+    // Numbers the nodes like the old dfsHelper and prints them like printDFS.
+    static void dfs(const RBTree& tree, Node* node, int& timer, vector<pair<Node*, pair<int, int>>>& order)
+    {
+        if (node == tree.nil)
+            return;
+        size_t index = order.size();
+        order.push_back(make_pair(node, make_pair(timer++, 0)));
+        dfs(tree, node->left, timer, order);
+        dfs(tree, node->right, timer, order);
+        order[index].second.second = timer++;
+    }
+
+    static string printRBT(const RBTree& tree)
+    {
+        ostringstream out;
+        printRBT(tree, tree.root, 0, out);
+        return out.str();
+    }
+
+    static string printDFS(const RBTree& tree, vector<pair<Node*, pair<int, int>>>& order)
+    {
+        int timer = 1;
+        order.clear();
+        dfs(tree, tree.root, timer, order);
+        ostringstream out;
+        for (size_t i = 0; i < order.size(); i++)
+        {
+            out << order[i].first->name << " (" << colorName(order[i].first) << "): d=" << order[i].second.first
+                << ", f=" << order[i].second.second << endl;
+        }
+        return out.str();
+    }
+
+    // The black height of the subtree, or -1 if it breaks an invariant:
+    // parent links, key order, a red node with a red child, or unequal
+    // black heights. Appends the keys in order.
+    static int blackHeight(const RBTree& tree, Node* node, vector<string>& keys)
+    {
+        if (node == tree.nil)
+            return 1;
+        if ((node->left != tree.nil && node->left->parent != node)
+            || (node->right != tree.nil && node->right->parent != node))
+            return -1;
+        if (node->color == RED && (node->left->color == RED || node->right->color == RED))
+            return -1;
+        int left = blackHeight(tree, node->left, keys);
+        if (left < 0 || (!keys.empty() && keys.back() >= node->name))
+            return -1;
+        keys.push_back(node->name);
+        int right = blackHeight(tree, node->right, keys);
+        if (right != left)
+            return -1;
+        return left + (node->color == BLACK ? 1 : 0);
+    }
+
+    static bool valid(const RBTree& tree, vector<string>& keys)
+    {
+        keys.clear();
+        return tree.root->color == BLACK && tree.root->parent == tree.nil && blackHeight(tree, tree.root, keys) > 0;
+    }
+};
+
+// The invariant IndexedHeap's sifts maintain: every live handle's position
+// holds a slot carrying that handle, every slot's handle points back at it,
+// and removed handles are marked absent.
+struct IndexedHeapReference
+{
+    template <typename T, typename Compare>
+    static bool positionsConsistent(const IndexedHeap<T, Compare>& heap)
+    {
+        size_t live = 0;
+        for (size_t handle = 0; handle < heap.position.size(); handle++)
+        {
+            size_t index = heap.position[handle];
+            if (index == IndexedHeap<T, Compare>::kAbsent)
+                continue;
+            if (index >= heap.data.size() || heap.data[index].handle != handle)
+                return false;
+            live++;
+        }
+        for (size_t index = 0; index < heap.data.size(); index++)
+        {
+            if (heap.position[heap.data[index].handle] != index)
+                return false;
+        }
+        return live == heap.data.size();
+    }
+};
+
+// ==================== BST ====================
+
+template <typename Subject>
+string displayed(Subject& subject)
+{
+    ostringstream shown;
+    streambuf* saved = cout.rdbuf(shown.rdbuf());
+    subject.display();
+    cout.rdbuf(saved);
+    return shown.str();
+}
+
+// Random inserts, removes and lookups against a multiset, with and without
+// duplicates. freeze() is called now and then, so lookups run on a fresh
+// snapshot, on a snapshot with pending deltas, and on the plain tree.
+bool checkFrozenLookups()
+{
+    for (int duplicates = 0; duplicates < 2; duplicates++)
+    {
+        for (unsigned seed = 1; seed <= 20; seed++)
+        {
+            mt19937 rng(seed);
+            BST tree(duplicates != 0);
+            multiset<int> reference;
+            for (int step = 0; step < 20000; step++)
+            {
+                int op = rng() % 10;
+                int value = static_cast<int>(rng() % 400) - 200;
+                if (op < 4)
+                {
+                    tree.insert(value);
+                    if (duplicates || reference.count(value) == 0)
+                        reference.insert(value);
+                }
+                else if (op < 6)
+                {
+                    tree.remove(value);
+                    multiset<int>::iterator it = reference.find(value);
+                    if (it != reference.end())
+                        reference.erase(it);
+                }
+                else if (op == 6 && rng() % 50 == 0)
+                {
+                    tree.freeze();
+                }
+                else if (tree.contains(value) != (reference.count(value) > 0))
+                {
+                    cerr << "  contains(" << value << ") wrong at step " << step << "\n";
+                    return false;
+                }
+            }
+            tree.freeze();
+            for (int value = -300; value < 300; value++)
+            {
+                if (tree.contains(value) != (reference.count(value) > 0))
+                {
+                    cerr << "  contains(" << value << ") wrong after the final freeze\n";
+                    return false;
+                }
+            }
+        }
+    }
+    BST empty;
+    empty.freeze();
+    if (empty.contains(0))
+    {
+        cerr << "  empty frozen tree contains 0\n";
+        return false;
+    }
+    empty.insert(5);
+    return empty.contains(5);
+}
+
+// select, rank and countRange against a multiset, and the cached maximum
+// against the spine walk, after every random insert or remove. Small key
+// ranges make long runs of equal values when duplicates are allowed.
+bool checkOrderStatistics()
+{
+    for (int duplicates = 0; duplicates < 2; duplicates++)
+    {
+        for (unsigned seed = 1; seed <= 30; seed++)
+        {
+            mt19937 rng(seed);
+            BST tree(duplicates != 0);
+            multiset<int> reference;
+            int range = seed % 3 == 0 ? 20 : 400;
+            for (int step = 0; step < 5000; step++)
+            {
+                int op = rng() % 10;
+                int value = static_cast<int>(rng() % range) - range / 2;
+                if (op < 5)
+                {
+                    tree.insert(value);
+                    if (duplicates || reference.count(value) == 0)
+                        reference.insert(value);
+                }
+                else if (op < 8)
+                {
+                    tree.remove(value);
+                    multiset<int>::iterator it = reference.find(value);
+                    if (it != reference.end())
+                        reference.erase(it);
+                }
+                else if (op == 8 && rng() % 20 == 0)
+                {
+                    tree.freeze();
+                }
+                if (tree.size() != reference.size())
+                {
+                    cerr << "  size wrong at step " << step << "\n";
+                    return false;
+                }
+                size_t k = rng() % (reference.size() + 2);
+                int selected = 0;
+                bool found = tree.select(k, selected);
+                if (found != (k >= 1 && k <= reference.size()))
+                {
+                    cerr << "  select(" << k << ") found wrongly at step " << step << "\n";
+                    return false;
+                }
+                if (found && *next(reference.begin(), k - 1) != selected)
+                {
+                    cerr << "  select(" << k << ") wrong at step " << step << "\n";
+                    return false;
+                }
+                int low = static_cast<int>(rng() % range) - range / 2;
+                int high = static_cast<int>(rng() % range) - range / 2;
+                size_t below = distance(reference.begin(), reference.lower_bound(low));
+                size_t inRange = low > high ? 0 : distance(reference.lower_bound(low), reference.upper_bound(high));
+                if (tree.rank(low) != below || tree.countRange(low, high) != inRange)
+                {
+                    cerr << "  rank or countRange wrong at step " << step << "\n";
+                    return false;
+                }
+                ostringstream shown;
+                streambuf* saved = cout.rdbuf(shown.rdbuf());
+                tree.showMaxElementAndLevel();
+                cout.rdbuf(saved);
+                if (shown.str() != BSTReference::maxElementAndLevel(tree)
+                    || tree.levelOfMax() != BSTReference::levelOfMax(tree))
+                {
+                    cerr << "  maximum or its level wrong at step " << step << "\n";
+                    return false;
+                }
+            }
+        }
+    }
+    return true;
+}
+
+// Compares the whole tree with reference: the in-order values, every node's
+// cached height and size, select and rank for every position, and the cached
+// maximum and its level. Returns what differs, or nullptr.
+const char* compareWithReference(BST& tree, const multiset<int>& reference)
+{
+    vector<int> values;
+    int height;
+    size_t size;
+    if (!BSTReference::collect(BSTReference::root(tree), values, height, size))
+        return "a cached height or size, or the key order";
+    if (values != vector<int>(reference.begin(), reference.end()) || tree.size() != reference.size())
+        return "the in-order values";
+    size_t below = 0;
+    for (size_t k = 1; k <= values.size(); k++)
+    {
+        if (k > 1 && values[k - 1] != values[k - 2])
+            below = k - 1;
+        int selected = 0;
+        if (!tree.select(k, selected) || selected != values[k - 1] || tree.rank(selected) != below)
+            return "select or rank";
+    }
+    ostringstream shown;
+    streambuf* saved = cout.rdbuf(shown.rdbuf());
+    tree.showMaxElementAndLevel();
+    cout.rdbuf(saved);
+    if (shown.str() != BSTReference::maxElementAndLevel(tree) || tree.levelOfMax() != BSTReference::levelOfMax(tree))
+        return "the maximum or its level";
+    return nullptr;
+}
+
+// buildFrom over random input, with and without duplicates, into empty,
+// populated and frozen trees. The result must match a reference everywhere,
+// be as short as possible without duplicates, and keep working under
+// random inserts and removes afterwards.
+bool checkBuildFrom()
+{
+    const size_t sizes[] = { 0, 1, 2, 3, 7, 8, 100, 1000, 4097 };
+    for (int duplicates = 0; duplicates < 2; duplicates++)
+    {
+        for (unsigned seed = 0; seed < 9; seed++)
+        {
+            mt19937 rng(seed);
+            BST tree(duplicates != 0);
+            for (unsigned i = 0; i < seed * 10; i++)
+            {
+                tree.insert(static_cast<int>(rng() % 1000));
+            }
+            if (seed % 3 == 2)
+            {
+                tree.freeze();
+            }
+            size_t n = sizes[seed];
+            int range = seed % 2 ? 10 : 1000000;
+            vector<int> values(n);
+            for (size_t i = 0; i < n; i++)
+            {
+                values[i] = static_cast<int>(rng() % range) - range / 2;
+            }
+            tree.buildFrom(values);
+            multiset<int> reference;
+            for (size_t i = 0; i < n; i++)
+            {
+                if (duplicates || reference.count(values[i]) == 0)
+                    reference.insert(values[i]);
+            }
+            const char* problem = compareWithReference(tree, reference);
+            int shortest = 0;
+            while ((size_t(1) << shortest) <= reference.size())
+            {
+                shortest++;
+            }
+            if (problem == nullptr && !duplicates && BSTReference::height(tree) != shortest)
+            {
+                problem = "the height";
+            }
+            for (int step = 0; problem == nullptr && step < 2000; step++)
+            {
+                int value = static_cast<int>(rng() % range) - range / 2;
+                if (rng() % 2)
+                {
+                    tree.insert(value);
+                    if (duplicates || reference.count(value) == 0)
+                        reference.insert(value);
+                }
+                else
+                {
+                    tree.remove(value);
+                    multiset<int>::iterator it = reference.find(value);
+                    if (it != reference.end())
+                        reference.erase(it);
+                }
+                if (tree.contains(value) != (reference.count(value) > 0))
+                {
+                    problem = "contains";
+                }
+                else if (step % 100 == 99)
+                {
+                    problem = compareWithReference(tree, reference);
+                }
+            }
+            if (problem != nullptr)
+            {
+                cerr << "  " << problem << " wrong after buildFrom of " << n << " values"
+                     << (duplicates ? " with duplicates" : "") << "\n";
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+// Random inserts and removes with a compact() every few hundred steps, so the
+// pool's free list, fresh chunks and spliced chunks all hand out nodes. The
+// whole tree is compared with the reference after every compact.
+bool checkCompact()
+{
+    for (int duplicates = 0; duplicates < 2; duplicates++)
+    {
+        for (unsigned seed = 1; seed <= 10; seed++)
+        {
+            mt19937 rng(seed);
+            BST tree(duplicates != 0);
+            multiset<int> reference;
+            int range = seed % 2 ? 50 : 100000;
+            for (int step = 0; step < 20000; step++)
+            {
+                int value = static_cast<int>(rng() % range) - range / 2;
+                // Phases of mostly inserts and mostly removes, so the tree
+                // grows and shrinks and the free list fills and drains.
+                bool growing = (step / 2000) % 2 == 0;
+                if (static_cast<int>(rng() % 10) < (growing ? 7 : 3))
+                {
+                    tree.insert(value);
+                    if (duplicates || reference.count(value) == 0)
+                        reference.insert(value);
+                }
+                else
+                {
+                    tree.remove(value);
+                    multiset<int>::iterator it = reference.find(value);
+                    if (it != reference.end())
+                        reference.erase(it);
+                }
+                if (rng() % 300 != 0)
+                {
+                    continue;
+                }
+                tree.compact();
+                const char* problem = compareWithReference(tree, reference);
+                if (problem != nullptr)
+                {
+                    cerr << "  " << problem << " wrong after compact at step " << step
+                         << (duplicates ? " with duplicates" : "") << "\n";
+                    return false;
+                }
+            }
+        }
+    }
+    return true;
+}
+
+// Runs check on a thread with a 256 KiB stack where the platform allows it,
+// so that recursion as deep as a degenerate tree overflows it for certain.
+bool onSmallStack(bool (*check)())
+{
+#if defined(__unix__) || defined(__APPLE__)
+    struct Call
+    {
+        bool (*check)();
+        bool passed;
+
+        static void* run(void* argument)
+        {
+            Call* call = static_cast<Call*>(argument);
+            call->passed = call->check();
+            return nullptr;
+        }
+    };
+    Call call = { check, false };
+    pthread_attr_t attributes;
+    pthread_attr_init(&attributes);
+    pthread_attr_setstacksize(&attributes, 256 * 1024);
+    pthread_t thread;
+    bool started = pthread_create(&thread, &attributes, Call::run, &call) == 0;
+    pthread_attr_destroy(&attributes);
+    if (started)
+    {
+        pthread_join(thread, nullptr);
+        return call.passed;
+    }
+#endif
+    return check();
+}
+
+// Ascending inserts make a right chain as deep as the tree is large. Every
+// operation on it must finish without recursing that deep, and the level
+// order output, the simple display, the frozen lookups and the order
+// statistics must still be right after removes from all along the chain.
+bool checkDeepChainOnStack()
+{
+    const int n = 20000;
+    BST tree(false);
+    for (int value = 0; value < n; value++)
+    {
+        tree.insert(value);
+    }
+    vector<bool> present(n, true);
+    for (int value = n - 1; value >= 0; value -= 97)
+    {
+        tree.remove(value);
+        present[value] = false;
+    }
+    tree.remove(0);
+    present[0] = false;
+    ostringstream traversal;
+    ostringstream simple;
+    traversal << "\nLevel Order Traversal: [";
+    int level = 0;
+    for (int value = 0; value < n; value++)
+    {
+        if (!present[value])
+            continue;
+        traversal << (level == 0 ? "" : ", ") << value;
+        simple << (level == 0 ? "" : "\n") << "Level " << level + 1 << ": " << value << " ";
+        level++;
+    }
+    traversal << "]\n";
+    simple << "\n";
+    ostringstream shown;
+    streambuf* saved = cout.rdbuf(shown.rdbuf());
+    tree.levelOrderTraversal();
+    string traversed = shown.str();
+    shown.str("");
+    tree.display();
+    string display = shown.str();
+    shown.str("");
+    tree.showMaxElementAndLevel();
+    cout.rdbuf(saved);
+    int largest = present[n - 1] ? n - 1 : n - 2;
+    if (traversed != traversal.str() || display.size() < simple.str().size()
+        || display.compare(display.size() - simple.str().size(), string::npos, simple.str()) != 0
+        || shown.str() != "Maximum Element: " + to_string(largest) + ", at Level: " + to_string(level) + "\n")
+    {
+        cerr << "  traversal, display or maximum of the " << level << "-level chain wrong\n";
+        return false;
+    }
+    int selected = 0;
+    if (!tree.select(level, selected) || selected != largest || tree.rank(n) != static_cast<size_t>(level))
+    {
+        cerr << "  order statistics of the chain wrong\n";
+        return false;
+    }
+    // Unfrozen lookups walk the chain, so only every 50th value is probed.
+    for (int frozen = 0; frozen < 2; frozen++)
+    {
+        if (frozen)
+            tree.freeze();
+        for (int value = -1; value <= n; value += frozen ? 1 : 50)
+        {
+            if (tree.contains(value) != (value >= 0 && value < n && present[value]))
+            {
+                cerr << "  contains(" << value << ") wrong on the " << (frozen ? "frozen " : "") << "chain\n";
+                return false;
+            }
+        }
+    }
+    tree.compact();
+    return tree.size() == static_cast<size_t>(level) && tree.levelOfMax() == level;
+}
+
+bool checkDeepChain()
+{
+    return onSmallStack(checkDeepChainOnStack);
+}
+
+// ==================== BST Display ====================
+
+// A small tree that fits, a chain cut off by the depth limit and a full tree
+// cut off by the width limit, exactly as display() prints them.
+const char* const kBalancedDisplayGolden =
+    "\n"
+    "Binary Search Tree Visual Representation:\n"
+    "\n"
+    "--- Balanced Display ---\n"
+    "   50\n"
+    "  /  \\\n"
+    " 30   70\n"
+    "/  \\ /  \\\n"
+    "20  40  60  80\n"
+    "   /      \\\n"
+    "  35  65\n"
+    "\n"
+    "--- Simple Level Order Display ---\n"
+    "Level 1: 50 \n"
+    "Level 2: 30 70 \n"
+    "Level 3: 20 40 60 80 \n"
+    "Level 4: 35 65 \n";
+const char* const kChainDisplayGolden =
+    "\n"
+    "Binary Search Tree Visual Representation:\n"
+    "\n"
+    "--- Balanced Display ---\n"
+    "1\n"
+    " \\\n"
+    "  2\n"
+    "   \\\n"
+    "   3\n"
+    "    \\\n"
+    "    4\n"
+    "(Showing 4 of 6 levels within 80 columns; the level order display lists every node.)\n"
+    "\n"
+    "--- Simple Level Order Display ---\n"
+    "Level 1: 1 \n"
+    "Level 2: 2 \n"
+    "Level 3: 3 \n"
+    "Level 4: 4 \n"
+    "Level 5: 5 \n"
+    "Level 6: 6 \n";
+const char* const kNarrowDisplayGolden =
+    "\n"
+    "Binary Search Tree Visual Representation:\n"
+    "\n"
+    "--- Balanced Display ---\n"
+    "   93\n"
+    "  /  \\\n"
+    " 45   141\n"
+    "/  \\ /   \\\n"
+    "21  69  117  165\n"
+    "/ \\/  \\/   \\/   \\\n"
+    "9  33  57  81  105  129  153  177\n"
+    "(Showing 4 of 6 levels within 40 columns; the level order display lists every node.)\n"
+    "\n"
+    "--- Simple Level Order Display ---\n"
+    "Level 1: 93 \n"
+    "Level 2: 45 141 \n"
+    "Level 3: 21 69 117 165 \n"
+    "Level 4: 9 33 57 81 105 129 153 177 \n"
+    "Level 5: 3 15 27 39 51 63 75 87 99 111 123 135 147 159 171 183 \n"
+    "Level 6: 0 6 12 18 24 30 36 42 48 54 60 66 72 78 84 90 96 102 108 114 120 126 132 138 144 150 156 162 168 174 180 186 \n";
+
+bool checkBalancedDisplayGoldens()
+{
+    const int small[] = { 50, 30, 70, 20, 40, 60, 80, 35, 65 };
+    BST balanced;
+    for (size_t i = 0; i < sizeof(small) / sizeof(small[0]); i++)
+    {
+        balanced.insert(small[i]);
+    }
+    BST chain;
+    ostringstream discarded;
+    streambuf* saved = cout.rdbuf(discarded.rdbuf());
+    for (int value = 1; value <= 6; value++)
+    {
+        chain.insert(value);
+    }
+    cout.rdbuf(saved);
+    chain.setDisplayLimits(4, 80);
+    BST narrow;
+    vector<int> values;
+    for (int i = 0; i < 63; i++)
+    {
+        values.push_back(3 * i);
+    }
+    narrow.buildFrom(values);
+    narrow.setDisplayLimits(BST::kDefaultDisplayDepth, 40);
+    if (displayed(balanced) != kBalancedDisplayGolden || displayed(chain) != kChainDisplayGolden
+        || displayed(narrow) != kNarrowDisplayGolden)
+    {
+        cerr << "  balanced display drawn differently\n";
+        return false;
+    }
+    return true;
+}
+
+// 1023 nodes at the default limits: too wide for the tenth level, so eight
+// levels fit in 1024 columns. The rows must stay inside the width, start at
+// the first occupied column, and be followed by the footer.
+bool checkWideBalancedDisplay()
+{
+    BST tree;
+    vector<int> values;
+    for (int i = 0; i < 1023; i++)
+    {
+        values.push_back(3 * i);
+    }
+    tree.buildFrom(values);
+    string shown = displayed(tree);
+    const string header = "\nBinary Search Tree Visual Representation:\n\n--- Balanced Display ---\n";
+    const string footer = "(Showing 8 of 10 levels within 1024 columns; the level order display lists every node.)\n";
+    const string simple = "\n--- Simple Level Order Display ---\n";
+    size_t end = shown.find(footer);
+    if (shown.compare(0, header.size(), header) != 0 || end == string::npos
+        || shown.compare(end + footer.size(), simple.size(), simple) != 0)
+    {
+        cerr << "  wide balanced display has the wrong header or footer\n";
+        return false;
+    }
+    istringstream rows(shown.substr(header.size(), end - header.size()));
+    string row;
+    size_t count = 0;
+    bool flushLeft = false;
+    while (getline(rows, row))
+    {
+        count++;
+        flushLeft = flushLeft || (!row.empty() && row[0] != ' ');
+        if (row.size() > static_cast<size_t>(BST::kDefaultDisplayWidth))
+        {
+            cerr << "  wide balanced display row " << count << " has " << row.size() << " columns\n";
+            return false;
+        }
+    }
+    if (count != 15 || !flushLeft)
+    {
+        cerr << "  wide balanced display shows " << count << " rows\n";
+        return false;
+    }
+    return true;
+}
+
+bool checkBalancedDisplay()
+{
+    return checkBalancedDisplayGoldens() && checkWideBalancedDisplay();
+}
+
+// ==================== Concurrent BST ====================
+
+// Every thread owns the keys congruent to its index, so it knows exactly
+// what each of its own operations must return even though all threads
+// reshape the same tree. Afterwards every key must be present exactly when
+// its owner last left it so.
+bool checkConcurrentBSTRun(size_t threadCount, size_t opsPerThread)
+{
+    const size_t keysPerThread = 1024;
+    ConcurrentBST tree;
+    atomic<size_t> mismatches(0);
+    vector<vector<bool>> present(threadCount, vector<bool>(keysPerThread));
+    vector<thread> threads;
+    for (size_t t = 0; t < threadCount; t++)
+    {
+        threads.push_back(thread([&tree, &mismatches, &present, t, threadCount, opsPerThread]() {
+            mt19937 rng(static_cast<unsigned>(77 + t));
+            vector<bool>& mine = present[t];
+            for (size_t i = 0; i < opsPerThread; i++)
+            {
+                size_t slot = rng() % mine.size();
+                int key = static_cast<int>(slot * threadCount + t);
+                int op = rng() % 3;
+                bool expected = op == 0 ? !mine[slot] : mine[slot];
+                bool result = op == 0 ? tree.insert(key) : op == 1 ? tree.remove(key) : tree.contains(key);
+                if (op == 0)
+                    mine[slot] = true;
+                else if (op == 1)
+                    mine[slot] = false;
+                if (result != expected)
+                    mismatches++;
+            }
+        }));
+    }
+    for (size_t t = 0; t < threadCount; t++)
+    {
+        threads[t].join();
+    }
+    for (size_t t = 0; t < threadCount; t++)
+    {
+        for (size_t slot = 0; slot < keysPerThread; slot++)
+        {
+            if (tree.contains(static_cast<int>(slot * threadCount + t)) != present[t][slot])
+                mismatches++;
+        }
+    }
+    if (mismatches != 0)
+    {
+        cerr << "  " << mismatches << " operations returned the wrong answer with " << threadCount << " threads"
+             << (yieldInCasWindows.load() ? ", yielding in the CAS windows" : "") << "\n";
+        return false;
+    }
+    return true;
+}
+
+// A plain run, then one that yields inside every CAS window.
+bool checkConcurrentBST()
+{
+    bool passed = checkConcurrentBSTRun(8, 100000);
+    yieldInCasWindows.store(true);
+    passed = passed && checkConcurrentBSTRun(4, 20000);
+    yieldInCasWindows.store(false);
+    return passed;
+}
+
+// ==================== Tree Canvas ====================
+
+// Fixed trees and heaps, and small random ones from fixed seeds, exactly as
+// display() prints them. Any change to the canvas layout shows up here.
+const char* const kLinkedTreeGolden =
+    "\n"
+    "Tree Visualization:\n"
+    "     1     \n"
+    "    / \\    \n"
+    "   2   3   \n"
+    "  / \\ / \\  \n"
+    "  4 6 5 108\n"
+    " /         \n"
+    "17         \n";
+const char* const kImplicitTreeGolden =
+    "\n"
+    "Tree Visualization:\n"
+    "      1    \n"
+    "     / \\   \n"
+    "    2   3  \n"
+    "   / \\ / \\ \n"
+    "   4 5 6 17\n"
+    "  /        \n"
+    "108        \n";
+const char* const kMinHeapGolden =
+    "\n"
+    "Heap Tree Visualization (MinHeap):\n"
+    "       0   \n"
+    "      / \\  \n"
+    "    1    2 \n"
+    "   / \\  / \\\n"
+    "  5   3 8 7\n"
+    " / \\ /     \n"
+    "40 6 9     \n";
+const char* const kMaxHeapGolden =
+    "\n"
+    "Heap Tree Visualization (MaxHeap):\n"
+    "      40   \n"
+    "     /  \\  \n"
+    "   9     8 \n"
+    "  / \\   / \\\n"
+    " 6   3  2 7\n"
+    "/ \\ /      \n"
+    "5 1 0      \n";
+const char* const kLinkedRandomGolden =
+    "\n"
+    "Tree Visualization:\n"
+    "                 -85          \n"
+    "                /   \\         \n"
+    "           -8            21   \n"
+    "          /  \\          /  \\  \n"
+    "      -14      47     -17  -21\n"
+    "     /   \\    /      /        \n"
+    "   -13   58  61     88        \n"
+    "  /                           \n"
+    "-69                           \n";
+const char* const kImplicitRandomGolden =
+    "\n"
+    "Tree Visualization:\n"
+    "                 -85          \n"
+    "                /   \\         \n"
+    "        -8               21   \n"
+    "       /  \\             /  \\  \n"
+    "   -14      -17        47  -13\n"
+    "  /   \\    /   \\      /       \n"
+    "-21   88  61   58   -69       \n";
+const char* const kHeapRandomGolden =
+    "\n"
+    "Heap Tree Visualization (MinHeap):\n"
+    "                       -842             \n"
+    "                      /    \\            \n"
+    "         -721                    -369   \n"
+    "        /    \\                  /    \\  \n"
+    "   283          -239          287    347\n"
+    "  /   \\        /    \\        /          \n"
+    "892   286    615    -12    721          \n";
+
+bool checkCanvasGoldens()
+{
+    const int fixed[] = { 1, 2, 3, 4, 5, 6, 17, 108 };
+    const int fixedHeap[] = { 5, 3, 8, 1, 9, 2, 7, 40, 6, 0 };
+    for (int implicit = 0; implicit < 2; implicit++)
+    {
+        BinaryTree tree(implicit != 0);
+        if (displayed(tree) != "\nTree Visualization:\n")
+        {
+            cerr << "  empty tree drawn wrongly\n";
+            return false;
+        }
+        for (size_t i = 0; i < sizeof(fixed) / sizeof(fixed[0]); i++)
+        {
+            tree.insert(fixed[i]);
+        }
+        mt19937 rng(7);
+        BinaryTree randomTree(implicit != 0);
+        for (int i = 0; i < 14; i++)
+        {
+            randomTree.insert(static_cast<int>(rng() % 200) - 100);
+        }
+        randomTree.removeLast();
+        randomTree.removeLast();
+        if (displayed(tree) != (implicit ? kImplicitTreeGolden : kLinkedTreeGolden)
+            || displayed(randomTree) != (implicit ? kImplicitRandomGolden : kLinkedRandomGolden))
+        {
+            cerr << "  " << (implicit ? "implicit" : "linked") << " BinaryTree drawn differently\n";
+            return false;
+        }
+    }
+    Heap heap;
+    for (size_t i = 0; i < sizeof(fixedHeap) / sizeof(fixedHeap[0]); i++)
+    {
+        heap.insert(fixedHeap[i]);
+    }
+    string minShown = displayed(heap);
+    heap.switchHeapType();
+    string maxShown = displayed(heap);
+    mt19937 rng(7);
+    Heap randomHeap;
+    for (int i = 0; i < 12; i++)
+    {
+        randomHeap.insert(static_cast<int>(rng() % 2000) - 1000);
+    }
+    if (minShown != kMinHeapGolden || maxShown != kMaxHeapGolden || displayed(randomHeap) != kHeapRandomGolden)
+    {
+        cerr << "  Heap drawn differently\n";
+        return false;
+    }
+    return true;
+}
+
+// Random BinaryTrees in both layouts, grown and shrunk, and random heaps of
+// every size up to a few hundred with short and long labels, against the old
+// recursive renderer.
+bool checkCanvasAgainstReference()
+{
+    for (unsigned seed = 1; seed <= 4; seed++)
+    {
+        mt19937 rng(seed);
+        BinaryTree linked;
+        BinaryTree implicit(true);
+        for (int step = 0; step < 400; step++)
+        {
+            if (rng() % 4 == 0)
+            {
+                linked.removeLast();
+                implicit.removeLast();
+            }
+            else
+            {
+                int value = static_cast<int>(rng() % 100000) - 50000;
+                linked.insert(value);
+                implicit.insert(value);
+            }
+            if (displayed(linked) != BinaryTreeReference::display(linked)
+                || displayed(implicit) != BinaryTreeReference::display(implicit))
+            {
+                cerr << "  BinaryTree canvas differs from the old renderer at step " << step << "\n";
+                return false;
+            }
+        }
+    }
+    mt19937 rng(11);
+    for (size_t n = 0; n < 300; n++)
+    {
+        int range = n % 2 ? 5 : 20000;
+        vector<int> values(n);
+        for (size_t i = 0; i < n; i++)
+        {
+            values[i] = static_cast<int>(rng() % range) - range / 2;
+        }
+        BasicHeap<int, less<int>> heap((vector<int>(values)));
+        LevelOrderView<int> view(heap.elements(), heap.size());
+        ostringstream shown;
+        streambuf* saved = cout.rdbuf(shown.rdbuf());
+        renderTreeCanvas(view, 0);
+        cout.rdbuf(saved);
+        if (shown.str() != CanvasReference::render(view, 0))
+        {
+            cerr << "  heap of " << n << " values drawn differently from the old renderer\n";
+            return false;
+        }
+    }
+    return true;
+}
+
+bool checkTreeCanvas()
+{
+    return checkCanvasGoldens() && checkCanvasAgainstReference();
+}
+
+// ==================== Binary Tree ====================
+
+bool checkBinaryTreeShape()
+{
+    const int removePercents[] = { 10, 30, 50, 70 };
+    for (int r = 0; r < 4; r++)
+    {
+        mt19937 rng(r + 1);
+        BinaryTree tree;
+        for (int step = 0; step < 20000; step++)
+        {
+            if (static_cast<int>(rng() % 100) < removePercents[r])
+            {
+                tree.removeLast();
+            }
+            else
+            {
+                tree.insert(step);
+            }
+            if (tree.isFull() != BinaryTreeReference::isFull(tree)
+                || tree.isComplete() != BinaryTreeReference::isComplete(tree)
+                || tree.isPerfect() != BinaryTreeReference::isPerfect(tree))
+            {
+                cerr << "  shape mismatch at step " << step << " with " << removePercents[r] << "% removes\n";
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+// The same random inserts and removeLasts on both layouts, against the stack
+// of inserted values. The implicit layout's level order is that stack. The
+// linked one balances sibling heights rather than filling levels left to
+// right, so its level order is a permutation of it; shapes, and with them
+// isFull/isComplete/isPerfect, differ by design. Lookups include values that
+// were never inserted or are already removed.
+bool checkBinaryTreeLayouts()
+{
+    for (unsigned seed = 1; seed <= 4; seed++)
+    {
+        mt19937 rng(seed);
+        BinaryTree linked;
+        BinaryTree implicit(true);
+        vector<int> inserted;
+        vector<int> everInserted;
+        for (int step = 0; step < 4000; step++)
+        {
+            if (rng() % 3 == 0)
+            {
+                bool expected = !inserted.empty();
+                if (linked.removeLast() != expected || implicit.removeLast() != expected)
+                {
+                    cerr << "  removeLast wrong at step " << step << "\n";
+                    return false;
+                }
+                if (expected)
+                    inserted.pop_back();
+            }
+            else
+            {
+                int value = static_cast<int>(rng() % 2000) - 1000;
+                linked.insert(value);
+                implicit.insert(value);
+                inserted.push_back(value);
+                everInserted.push_back(value);
+            }
+            vector<int> probes(8);
+            vector<bool> expected(probes.size());
+            for (size_t i = 0; i < probes.size(); i++)
+            {
+                probes[i] = i % 2 == 0 && !everInserted.empty() ? everInserted[rng() % everInserted.size()]
+                                                                : static_cast<int>(rng() % 2400) - 1200;
+                expected[i] = find(inserted.begin(), inserted.end(), probes[i]) != inserted.end();
+            }
+            if (linked.existsMany(probes) != expected || implicit.existsMany(probes) != expected
+                || linked.exists(probes[0]) != expected[0] || implicit.exists(probes[0]) != expected[0])
+            {
+                cerr << "  exists/existsMany wrong at step " << step << "\n";
+                return false;
+            }
+            if (step % 16 != 0)
+                continue;
+            vector<int> implicitOrder = BinaryTreeReference::levelOrder(implicit);
+            vector<int> linkedOrder = BinaryTreeReference::levelOrder(linked);
+            vector<int> sorted(inserted);
+            sort(sorted.begin(), sorted.end());
+            sort(linkedOrder.begin(), linkedOrder.end());
+            if (implicitOrder != inserted || linkedOrder != sorted)
+            {
+                cerr << "  level order holds the wrong values at step " << step << "\n";
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+// ==================== Heap ====================
+
+const int kExtremeKeys[] = { numeric_limits<int>::min(), numeric_limits<int>::min() + 1, -1, 0, 1,
+                             numeric_limits<int>::max() - 1, numeric_limits<int>::max() };
+
+// Uniform, duplicate-heavy, or drawn from the extremes of int.
+vector<int> heapInput(mt19937& rng, size_t n, int kind)
+{
+    vector<int> values(n);
+    for (size_t i = 0; i < n; i++)
+    {
+        if (kind == 0)
+            values[i] = static_cast<int>(rng());
+        else if (kind == 1)
+            values[i] = rng() % 4;
+        else
+            values[i] = kExtremeKeys[rng() % 7];
+    }
+    return values;
+}
+
+template <typename Subject>
+vector<int> drainHeap(Subject& heap)
+{
+    vector<int> drained;
+    while (!heap.isEmpty())
+    {
+        drained.push_back(heap.getRoot());
+        heap.removeRoot();
+    }
+    return drained;
+}
+
+// Full sibling groups, filled with ties and extreme keys, through the
+// selector the heap uses (the SSE2 lane reduction for int with less or
+// greater at arity 4 and 8) against a leftmost sequential scan.
+template <typename Compare, int Arity>
+bool checkChildSelector(unsigned seed)
+{
+    mt19937 rng(seed);
+    Compare compare;
+    vector<int, CacheAlignedAllocator<int>> group(Arity);
+    for (int trial = 0; trial < 100000; trial++)
+    {
+        for (int i = 0; i < Arity; i++)
+        {
+            group[i] = trial % 2 ? kExtremeKeys[rng() % 7] : static_cast<int>(rng() % 3);
+        }
+        size_t expected = 0;
+        for (int i = 1; i < Arity; i++)
+        {
+            if (compare(group[i], group[expected]))
+                expected = i;
+        }
+        if (ChildSelector<int, Compare, Arity>::select(group.data(), compare) != expected)
+        {
+            cerr << "  arity " << Arity << " selector picks the wrong child of";
+            for (int i = 0; i < Arity; i++)
+            {
+                cerr << " " << group[i];
+            }
+            cerr << "\n";
+            return false;
+        }
+    }
+    return true;
+}
+
+// Fills one BasicHeap per construction path with the same values and drains
+// each through removeRoot against a sorted copy: one insert at a time, the
+// vector&& constructor, and insertBatch in random chunks. Two more heaps take
+// one batch behind a prefix of the input, sized to either side of
+// preferHeapify's threshold: no larger than the prefix, so it is sifted up,
+// and one or two larger, so the whole heap is rebuilt. A last heap swaps its
+// root for other input values through replaceRoot before draining.
+template <typename Compare, int Arity>
+bool checkDaryHeapCase(const vector<int>& values, unsigned seed)
+{
+    typedef BasicHeap<int, Compare, Arity> Subject;
+    mt19937 rng(seed);
+    Compare compare;
+    vector<int> expected(values);
+    sort(expected.begin(), expected.end(), compare);
+    Subject inserted;
+    for (size_t i = 0; i < values.size(); i++)
+    {
+        inserted.insert(values[i]);
+    }
+    Subject built((vector<int>(values)));
+    Subject batched;
+    for (size_t i = 0; i < values.size();)
+    {
+        size_t count = min<size_t>(rng() % 17 + 1, values.size() - i);
+        batched.insertBatch(values.begin() + i, values.begin() + i + count);
+        i += count;
+    }
+    size_t appendPrefix = (values.size() + 1) / 2;
+    size_t heapifyPrefix = values.size() > 0 ? (values.size() - 1) / 2 : 0;
+    Subject appended;
+    Subject heapified;
+    for (size_t i = 0; i < appendPrefix; i++)
+    {
+        appended.insert(values[i]);
+    }
+    for (size_t i = 0; i < heapifyPrefix; i++)
+    {
+        heapified.insert(values[i]);
+    }
+    appended.insertBatch(values.begin() + appendPrefix, values.end());
+    heapified.insertBatch(values.begin() + heapifyPrefix, values.end());
+    const char* failed = nullptr;
+    if (drainHeap(inserted) != expected)
+        failed = "insert";
+    else if (drainHeap(built) != expected)
+        failed = "the vector&& constructor";
+    else if (drainHeap(batched) != expected)
+        failed = "insertBatch";
+    else if (drainHeap(appended) != expected)
+        failed = "an insertBatch sifted up";
+    else if (drainHeap(heapified) != expected)
+        failed = "an insertBatch that rebuilds";
+    Subject replaced((vector<int>(values)));
+    multiset<int, Compare> reference(values.begin(), values.end());
+    for (size_t i = 0; failed == nullptr && i < values.size(); i++)
+    {
+        int value = values[rng() % values.size()];
+        if (replaced.getRoot() != *reference.begin())
+        {
+            failed = "replaceRoot";
+            break;
+        }
+        replaced.replaceRoot(value);
+        reference.erase(reference.begin());
+        reference.insert(value);
+    }
+    if (failed == nullptr && drainHeap(replaced) != vector<int>(reference.begin(), reference.end()))
+    {
+        failed = "replaceRoot";
+    }
+    if (failed != nullptr)
+    {
+        cerr << "  arity " << Arity << " heap of " << values.size() << " values drains out of order after "
+             << failed << "\n";
+        return false;
+    }
+    return true;
+}
+
+// Every size up to a few sibling groups, so the last group is partial in
+// every possible way, then a few larger heaps.
+template <typename Compare, int Arity>
+bool checkDaryHeapArity()
+{
+    if (!checkChildSelector<Compare, Arity>(Arity))
+    {
+        return false;
+    }
+    const size_t largeSizes[] = { 257, 1000, 4099 };
+    for (int kind = 0; kind < 3; kind++)
+    {
+        mt19937 rng(Arity * 3 + kind);
+        for (size_t n = 0; n < 4 * Arity + 12; n++)
+        {
+            if (!checkDaryHeapCase<Compare, Arity>(heapInput(rng, n, kind), rng()))
+                return false;
+        }
+        for (size_t i = 0; i < 3; i++)
+        {
+            if (!checkDaryHeapCase<Compare, Arity>(heapInput(rng, largeSizes[i], kind), rng()))
+                return false;
+        }
+    }
+    return true;
+}
+
+bool checkDaryHeap()
+{
+    return checkDaryHeapArity<less<int>, 2>() && checkDaryHeapArity<greater<int>, 2>()
+        && checkDaryHeapArity<less<int>, 3>() && checkDaryHeapArity<greater<int>, 3>()
+        && checkDaryHeapArity<less<int>, 4>() && checkDaryHeapArity<greater<int>, 4>()
+        && checkDaryHeapArity<less<int>, 8>() && checkDaryHeapArity<greater<int>, 8>();
+}
+
+// Random inserts and removals from both ends, with few and with many distinct
+// values, against the two ends of a multiset. The Heap wrapper in min-max mode
+// is driven alongside, flipping its type at random and removing its root.
+bool checkMinMaxHeap()
+{
+    for (unsigned seed = 0; seed < 20; seed++)
+    {
+        mt19937 rng(seed);
+        int range = seed % 2 ? 7 : 100000;
+        MinMaxHeap<int> heap;
+        multiset<int> reference;
+        Heap wrapper(true, MinMaxHeapKind);
+        bool wrapperMin = true;
+        multiset<int> wrapperReference;
+        for (int step = 0; step < 20000; step++)
+        {
+            int op = rng() % 10;
+            int value = rng() % range;
+            if (op < 5 || reference.empty())
+            {
+                heap.insert(value);
+                reference.insert(value);
+            }
+            else if (op < 7)
+            {
+                if (heap.getMin() != *reference.begin())
+                {
+                    cerr << "  wrong minimum at step " << step << "\n";
+                    return false;
+                }
+                heap.removeMin();
+                reference.erase(reference.begin());
+            }
+            else
+            {
+                if (heap.getMax() != *reference.rbegin())
+                {
+                    cerr << "  wrong maximum at step " << step << "\n";
+                    return false;
+                }
+                heap.removeMax();
+                reference.erase(prev(reference.end()));
+            }
+            if (heap.size() != reference.size()
+                || (!reference.empty() && (heap.getMin() != *reference.begin() || heap.getMax() != *reference.rbegin())))
+            {
+                cerr << "  ends or size wrong at step " << step << "\n";
+                return false;
+            }
+
+            op = rng() % 10;
+            if (op < 5 || wrapperReference.empty())
+            {
+                wrapper.insert(value);
+                wrapperReference.insert(value);
+                continue;
+            }
+            if (op == 5)
+            {
+                wrapper.switchHeapType();
+                wrapperMin = !wrapperMin;
+            }
+            multiset<int>::iterator root = wrapperMin ? wrapperReference.begin() : prev(wrapperReference.end());
+            if (wrapper.getRoot() != *root)
+            {
+                cerr << "  wrong Heap root at step " << step << "\n";
+                return false;
+            }
+            wrapper.removeRoot();
+            wrapperReference.erase(root);
+        }
+    }
+    return true;
+}
+
+// Random inserts, updates in both directions, erases and root removals
+// against a multiset of the values and a map from each live handle to its
+// value. Handles must be unique among the live ones even as they are
+// recycled, and the position map must agree with the slots after every step.
+template <typename Compare>
+bool checkIndexedHeapCase(unsigned seed, int range)
+{
+    typedef typename IndexedHeap<int, Compare>::Handle Handle;
+    mt19937 rng(seed);
+    IndexedHeap<int, Compare> heap;
+    multiset<int, Compare> reference;
+    unordered_map<Handle, int> values;
+    vector<Handle> live;
+    vector<Handle> removed;
+    for (int step = 0; step < 20000; step++)
+    {
+        int op = rng() % 10;
+        int value = static_cast<int>(rng() % range) - range / 2;
+        if (op < 4 || live.empty())
+        {
+            Handle handle = heap.insert(value);
+            if (values.count(handle) != 0)
+            {
+                cerr << "  handle " << handle << " handed out twice at step " << step << "\n";
+                return false;
+            }
+            values[handle] = value;
+            live.push_back(handle);
+            reference.insert(value);
+        }
+        else if (op < 7)
+        {
+            // A fresh random value, so updates move toward the root, away
+            // from it, or nowhere about equally often.
+            Handle handle = live[rng() % live.size()];
+            reference.erase(reference.find(values[handle]));
+            reference.insert(value);
+            values[handle] = value;
+            heap.update(handle, value);
+        }
+        else if (op < 8)
+        {
+            size_t pick = rng() % live.size();
+            Handle handle = live[pick];
+            live[pick] = live.back();
+            live.pop_back();
+            reference.erase(reference.find(values[handle]));
+            values.erase(handle);
+            removed.push_back(handle);
+            heap.erase(handle);
+        }
+        else
+        {
+            Handle handle = heap.rootHandle();
+            if (heap.getRoot() != *reference.begin() || values.count(handle) == 0 || values[handle] != heap.getRoot())
+            {
+                cerr << "  wrong root at step " << step << "\n";
+                return false;
+            }
+            live.erase(find(live.begin(), live.end(), handle));
+            reference.erase(reference.begin());
+            values.erase(handle);
+            removed.push_back(handle);
+            heap.removeRoot();
+        }
+        if (heap.size() != reference.size() || !IndexedHeapReference::positionsConsistent(heap))
+        {
+            cerr << "  size or position map wrong at step " << step << "\n";
+            return false;
+        }
+        if (!reference.empty() && heap.getRoot() != *reference.begin())
+        {
+            cerr << "  wrong root at step " << step << "\n";
+            return false;
+        }
+        Handle probe = live.empty() ? 0 : live[rng() % live.size()];
+        if (!live.empty() && (!heap.contains(probe) || heap.get(probe) != values[probe]))
+        {
+            cerr << "  handle " << probe << " lost its value at step " << step << "\n";
+            return false;
+        }
+        if (!removed.empty())
+        {
+            Handle gone = removed[rng() % removed.size()];
+            if (heap.contains(gone) != (values.count(gone) != 0))
+            {
+                cerr << "  contains(" << gone << ") wrong at step " << step << "\n";
+                return false;
+            }
+        }
+    }
+    while (!reference.empty())
+    {
+        if (heap.getRoot() != *reference.begin())
+        {
+            cerr << "  wrong root while draining\n";
+            return false;
+        }
+        heap.removeRoot();
+        reference.erase(reference.begin());
+    }
+    return heap.isEmpty() && IndexedHeapReference::positionsConsistent(heap);
+}
+
+bool checkIndexedHeap()
+{
+    for (unsigned seed = 1; seed <= 10; seed++)
+    {
+        int range = seed % 2 ? 10 : 100000;
+        if (!checkIndexedHeapCase<less<int>>(seed, range) || !checkIndexedHeapCase<greater<int>>(seed, range))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Random inserts, batches and removeRoots on one heap while a second heap
+// grows and is merged in now and then, against multisets. Merges splice the
+// second heap's pool into the first, so later removes free nodes carved out
+// of the other pool, and the emptied heap starts over with a fresh pool.
+template <typename Compare>
+bool checkPairingHeapCase(unsigned seed, int range)
+{
+    mt19937 rng(seed);
+    PairingHeap<int, Compare> heap;
+    PairingHeap<int, Compare>* other = new PairingHeap<int, Compare>();
+    multiset<int, Compare> reference;
+    multiset<int, Compare> otherReference;
+    for (int step = 0; step < 20000; step++)
+    {
+        int op = rng() % 20;
+        int value = static_cast<int>(rng() % range) - range / 2;
+        if (op < 6)
+        {
+            heap.insert(value);
+            reference.insert(value);
+        }
+        else if (op < 10)
+        {
+            other->insert(value);
+            otherReference.insert(value);
+        }
+        else if (op < 11)
+        {
+            vector<int> batch(rng() % 17);
+            for (size_t i = 0; i < batch.size(); i++)
+            {
+                batch[i] = static_cast<int>(rng() % range) - range / 2;
+            }
+            heap.insertBatch(batch.begin(), batch.end());
+            reference.insert(batch.begin(), batch.end());
+        }
+        else if (op < 12)
+        {
+            heap.merge(*other);
+            heap.merge(heap);
+            reference.insert(otherReference.begin(), otherReference.end());
+            otherReference.clear();
+            if (!other->isEmpty() || other->size() != 0)
+            {
+                cerr << "  merged heap not left empty at step " << step << "\n";
+                delete other;
+                return false;
+            }
+            // The merged nodes must have left along with the pool, so they
+            // outlive the heap they came from.
+            delete other;
+            other = new PairingHeap<int, Compare>();
+        }
+        else if (!reference.empty())
+        {
+            if (heap.getRoot() != *reference.begin())
+            {
+                cerr << "  root " << heap.getRoot() << " instead of " << *reference.begin() << " at step " << step << "\n";
+                delete other;
+                return false;
+            }
+            heap.removeRoot();
+            reference.erase(reference.begin());
+        }
+        if (heap.size() != reference.size() || heap.isEmpty() != reference.empty()
+            || other->size() != otherReference.size())
+        {
+            cerr << "  size " << heap.size() << " instead of " << reference.size() << " at step " << step << "\n";
+            delete other;
+            return false;
+        }
+    }
+    heap.merge(*other);
+    delete other;
+    reference.insert(otherReference.begin(), otherReference.end());
+    vector<int> released = heap.release();
+    sort(released.begin(), released.end(), Compare());
+    if (!heap.isEmpty() || !equal(released.begin(), released.end(), reference.begin()))
+    {
+        cerr << "  release() handed out the wrong values\n";
+        return false;
+    }
+    for (typename multiset<int, Compare>::iterator it = reference.begin(); it != reference.end(); ++it)
+    {
+        heap.insert(*it);
+    }
+    for (typename multiset<int, Compare>::iterator it = reference.begin(); it != reference.end(); ++it)
+    {
+        if (heap.getRoot() != *it)
+        {
+            cerr << "  drain after release() out of order\n";
+            return false;
+        }
+        heap.removeRoot();
+    }
+    return heap.isEmpty();
+}
+
+bool checkPairingHeap()
+{
+    for (unsigned seed = 1; seed <= 6; seed++)
+    {
+        int range = seed % 2 ? 10 : 100000;
+        if (!checkPairingHeapCase<less<int>>(seed, range) || !checkPairingHeapCase<greater<int>>(seed, range))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Random inserts and removals against a multiset. After every step the values
+// buffered in memory must stay within the limit, unless the limit is too
+// small for the head and one-value block every open run keeps regardless.
+template <typename Compare>
+bool checkExternalHeapCase(unsigned seed, size_t limit, size_t blockBytes)
+{
+    mt19937 rng(seed);
+    ExternalHeap<long long, Compare> heap(limit, blockBytes);
+    multiset<long long, Compare> reference;
+    for (int step = 0; step < 100000; step++)
+    {
+        if (rng() % 5 < 3 || reference.empty())
+        {
+            long long value = rng() % 5000;
+            if (!heap.insert(value))
+            {
+                cerr << "  insert failed at step " << step << "\n";
+                return false;
+            }
+            reference.insert(value);
+        }
+        else
+        {
+            if (heap.getRoot() != *reference.begin())
+            {
+                cerr << "  wrong root at step " << step << "\n";
+                return false;
+            }
+            heap.removeRoot();
+            reference.erase(reference.begin());
+        }
+        if (heap.size() != reference.size() || heap.isEmpty() != reference.empty())
+        {
+            cerr << "  size mismatch at step " << step << "\n";
+            return false;
+        }
+        size_t bound = max(limit, max<size_t>(limit / 2, 1) + 2 * heap.runSlots());
+        if (heap.bufferedValues() > bound || heap.runSlots() > 100)
+        {
+            cerr << "  " << heap.bufferedValues() << " values buffered in " << heap.runSlots()
+                 << " run slots with a limit of " << limit << " at step " << step << "\n";
+            return false;
+        }
+    }
+    while (!reference.empty())
+    {
+        if (heap.getRoot() != *reference.begin())
+        {
+            cerr << "  wrong root while draining\n";
+            return false;
+        }
+        heap.removeRoot();
+        reference.erase(reference.begin());
+    }
+    return heap.isEmpty() && !heap.failed();
+}
+
+// With no file descriptors left, run files cannot be created: inserts must
+// start failing once the in-memory half of the limit is full, without the
+// heap growing past it, and everything accepted must still come back out.
+bool checkExternalHeapIoFailure()
+{
+#if defined(__unix__) || defined(__APPLE__)
+    const size_t limit = 64;
+    ExternalHeap<int> heap(limit, 16);
+    multiset<int> accepted;
+    for (int value = 0; value < 200; value++)
+    {
+        heap.insert(199 - value);
+        accepted.insert(199 - value);
+    }
+    rlimit saved;
+    getrlimit(RLIMIT_NOFILE, &saved);
+    rlimit none = saved;
+    none.rlim_cur = 0;
+    setrlimit(RLIMIT_NOFILE, &none);
+    size_t rejected = 0;
+    for (int value = 200; value < 400; value++)
+    {
+        if (heap.insert(value))
+            accepted.insert(value);
+        else
+            rejected++;
+    }
+    bool bounded = heap.bufferedValues() <= limit;
+    setrlimit(RLIMIT_NOFILE, &saved);
+    if (rejected == 0 || !bounded || !heap.failed())
+    {
+        cerr << "  " << rejected << " inserts rejected, " << heap.bufferedValues() << " values buffered\n";
+        return false;
+    }
+    for (multiset<int>::iterator it = accepted.begin(); it != accepted.end(); ++it)
+    {
+        if (heap.isEmpty() || heap.getRoot() != *it)
+        {
+            cerr << "  accepted value " << *it << " lost\n";
+            return false;
+        }
+        heap.removeRoot();
+    }
+    return heap.isEmpty();
+#else
+    return true;
+#endif
+}
+
+bool checkExternalHeap()
+{
+    return checkExternalHeapCase<less<long long>>(1, 1000, 64)
+        && checkExternalHeapCase<greater<long long>>(2, 100, 8)
+        && checkExternalHeapCase<less<long long>>(3, 5000, 1 << 20)
+        && checkExternalHeapCase<less<long long>>(4, 1, 1)
+        && checkExternalHeapIoFailure();
+}
+
+// Four threads each push their own residue class of values while popping at
+// random. Whatever is left is drained at the end; every value pushed must have
+// come out exactly once, and the lane counters must agree.
+bool checkMultiQueue()
+{
+    const size_t threadCount = 4;
+    const size_t perThread = 50000;
+    MultiQueue<int> queue(2 * threadCount);
+    vector<vector<int>> popped(threadCount);
+    vector<thread> threads;
+    for (size_t t = 0; t < threadCount; t++)
+    {
+        threads.push_back(thread([&queue, &popped, t, threadCount, perThread]() {
+            mt19937 rng(static_cast<unsigned>(t + 1));
+            for (size_t i = 0; i < perThread; i++)
+            {
+                queue.push(static_cast<int>(i * threadCount + t));
+                int value;
+                if (rng() % 2 == 0 && queue.tryPop(value))
+                    popped[t].push_back(value);
+            }
+        }));
+    }
+    for (size_t t = 0; t < threadCount; t++)
+    {
+        threads[t].join();
+    }
+    vector<int> all;
+    int value;
+    while (queue.tryPop(value))
+    {
+        all.push_back(value);
+    }
+    for (size_t t = 0; t < threadCount; t++)
+    {
+        all.insert(all.end(), popped[t].begin(), popped[t].end());
+    }
+    sort(all.begin(), all.end());
+    MultiQueueStats stats = queue.stats();
+    bool exact = all.size() == threadCount * perThread;
+    for (size_t i = 0; exact && i < all.size(); i++)
+    {
+        exact = all[i] == static_cast<int>(i);
+    }
+    if (!exact || stats.pushes != all.size() || stats.pops != all.size())
+    {
+        cerr << "  " << all.size() << " values popped, " << stats.pushes << " pushes and " << stats.pops
+             << " pops counted, expected " << threadCount * perThread << " each\n";
+        return false;
+    }
+    return true;
+}
+
+// k from 0 to 36 over up to 3000 values, fed one at a time and in random
+// chunks through the fast-reject path, against a full sort.
+template <typename T, typename Compare>
+bool checkTopKCase(unsigned seed, size_t k, size_t n, bool batch)
+{
+    mt19937 rng(seed);
+    vector<T> values(n);
+    for (size_t i = 0; i < n; i++)
+    {
+        values[i] = T(rng() % 2000) - 1000;
+    }
+    TopK<T, Compare> top(k);
+    if (batch)
+    {
+        for (size_t i = 0; i < n;)
+        {
+            size_t count = min<size_t>(rng() % 50 + 1, n - i);
+            top.offerBatch(values.data() + i, count);
+            i += count;
+        }
+    }
+    else
+    {
+        for (size_t i = 0; i < n; i++)
+        {
+            top.offer(values[i]);
+        }
+    }
+    vector<T> expected(values);
+    Compare compare;
+    sort(expected.begin(), expected.end(), [&compare](const T& a, const T& b) { return compare(b, a); });
+    expected.resize(min(k, n));
+    if (top.sorted() != expected)
+    {
+        cerr << "  top " << k << " of " << n << " wrong" << (batch ? " with offerBatch" : "") << "\n";
+        return false;
+    }
+    return true;
+}
+
+// The --topk path: integers in a file over 1 MiB, so numbers are split across
+// reads, with mixed separators. Every integer must parse back exactly, and
+// the printed top k must match a full sort.
+template <typename Compare>
+bool checkPrintTopK(unsigned seed, size_t k)
+{
+    mt19937 rng(seed);
+    FILE* file = tmpfile();
+    if (file == nullptr)
+    {
+        cerr << "  cannot create a temporary file\n";
+        return false;
+    }
+    const char separators[] = " \n\t,;";
+    vector<int> values(300000);
+    for (size_t i = 0; i < values.size(); i++)
+    {
+        values[i] = static_cast<int>(rng());
+        fprintf(file, "%d%c", values[i], separators[rng() % 5]);
+    }
+    rewind(file);
+    vector<int> parsed;
+    bool ok = streamIntegers(file, [&parsed](const int* chunk, size_t count) {
+        parsed.insert(parsed.end(), chunk, chunk + count);
+    });
+    rewind(file);
+    ostringstream printed;
+    streambuf* saved = cout.rdbuf(printed.rdbuf());
+    ok = printTopK<Compare>(file, k) && ok;
+    cout.rdbuf(saved);
+    fclose(file);
+    if (parsed != values)
+    {
+        cerr << "  the " << parsed.size() << " integers parsed differ from the " << values.size() << " written\n";
+        return false;
+    }
+    Compare compare;
+    sort(values.begin(), values.end(), [&compare](int a, int b) { return compare(b, a); });
+    ostringstream expected;
+    for (size_t i = 0; i < k; i++)
+    {
+        expected << values[i] << "\n";
+    }
+    if (!ok || printed.str() != expected.str())
+    {
+        cerr << "  --topk " << k << " output differs from a full sort\n";
+        return false;
+    }
+    return true;
+}
+
+bool checkTopK()
+{
+    for (unsigned seed = 0; seed < 300; seed++)
+    {
+        size_t k = seed % 37;
+        size_t n = (seed * 7919) % 3000;
+        for (int batch = 0; batch < 2; batch++)
+        {
+            if (!checkTopKCase<int, less<int>>(seed, k, n, batch) || !checkTopKCase<int, greater<int>>(seed, k, n, batch)
+                || !checkTopKCase<long long, less<long long>>(seed, k, n, batch)
+                || !checkTopKCase<long long, greater<long long>>(seed, k, n, batch))
+            {
+                return false;
+            }
+        }
+    }
+    return checkPrintTopK<less<int>>(1, 100) && checkPrintTopK<greater<int>>(2, 1000);
+}
+
+// ==================== Red-Black Tree ====================
+
+// A random session of unique inserts, deletes and lookups against a
+// std::set. Every so often the tree must be a valid red-black tree holding
+// exactly the set's keys, print-rbt and dfs must print what the recursive
+// walks printed, and queries must find the node with given timestamps.
+bool checkRBTree()
+{
+    for (unsigned seed = 1; seed <= 5; seed++)
+    {
+        mt19937 rng(seed);
+        RBTree tree;
+        set<string> reference;
+        vector<pair<Node*, pair<int, int>>> order;
+        vector<string> keys;
+        for (int step = 0; step < 5000; step++)
+        {
+            string key = "k" + to_string(rng() % (seed * 200));
+            int op = rng() % 3;
+            bool result = op == 0 ? tree.insertUnique(key) : op == 1 ? tree.deleteNode(key) : tree.contains(key);
+            bool expected = op == 0 ? reference.insert(key).second
+                : op == 1           ? reference.erase(key) == 1
+                                    : reference.count(key) == 1;
+            if (result != expected)
+            {
+                cerr << "  operation " << op << " on " << key << " wrong at step " << step << "\n";
+                return false;
+            }
+            if (step % 50 != 0)
+            {
+                continue;
+            }
+            if (!RBTreeReference::valid(tree, keys) || keys != vector<string>(reference.begin(), reference.end()))
+            {
+                cerr << "  red-black invariants or keys wrong at step " << step << "\n";
+                return false;
+            }
+            ostringstream shown;
+            streambuf* saved = cout.rdbuf(shown.rdbuf());
+            tree.printRBT();
+            string printed = shown.str();
+            shown.str("");
+            tree.dfs();
+            tree.printDFS();
+            string dfs = shown.str();
+            shown.str("");
+            string expectedDFS = RBTreeReference::printDFS(tree, order);
+            ostringstream expectedQueries;
+            for (int query = 0; query < 5; query++)
+            {
+                if (!order.empty() && query % 2 == 0)
+                {
+                    const pair<Node*, pair<int, int>>& target = order[rng() % order.size()];
+                    tree.query(target.second.first, target.second.second);
+                    expectedQueries << "Output: Node " << target.first->name << " ("
+                                    << RBTreeReference::colorName(target.first) << ")" << endl;
+                }
+                else
+                {
+                    int d = static_cast<int>(rng() % (2 * order.size() + 2)) + 1;
+                    tree.query(d, d);
+                    expectedQueries << "Invalid Operation" << endl;
+                }
+            }
+            cout.rdbuf(saved);
+            if (printed != RBTreeReference::printRBT(tree) || dfs != expectedDFS
+                || shown.str() != expectedQueries.str())
+            {
+                cerr << "  print-rbt, dfs or query output differs at step " << step << "\n";
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+// ==================== Profiling ====================
+
+#ifdef TREES_PROFILE
+// Every value must land in a bucket whose limit is at or above it and within
+// 1/16 of it, and consecutive bucket limits must increase.
+bool checkProfileBuckets()
+{
+    mt19937_64 rng(1);
+    for (int i = 0; i < 1000000; i++)
+    {
+        uint64_t value = rng() >> (rng() % 64);
+        uint64_t limit = profileBucketLimit(profileBucket(value));
+        if (limit < value || limit - value > value / 16)
+        {
+            cerr << "  " << value << " lands in a bucket ending at " << limit << "\n";
+            return false;
+        }
+    }
+    for (int bucket = 1; bucket < kProfileBuckets; bucket++)
+    {
+        if (profileBucketLimit(bucket) <= profileBucketLimit(bucket - 1)
+            || profileBucket(profileBucketLimit(bucket)) != bucket)
+        {
+            cerr << "  bucket " << bucket << " does not round-trip\n";
+            return false;
+        }
+    }
+    return true;
+}
+
+// The count the stats report for site, or 0 before its first call.
+unsigned long long profiledCount(const string& site)
+{
+    ostringstream stats;
+    Profiler::instance().printStats(stats);
+    istringstream lines(stats.str());
+    string line;
+    while (getline(lines, line))
+    {
+        istringstream fields(line);
+        string name;
+        unsigned long long count = 0;
+        if (fields >> name >> count && name == site)
+        {
+            return count;
+        }
+    }
+    return 0;
+}
+
+// Four threads record BST inserts while this thread keeps printing stats;
+// afterwards the report must have counted every one of those inserts.
+bool checkProfileThreads()
+{
+    const int threadCount = 4;
+    const int perThread = 20000;
+    unsigned long long before = profiledCount("BST::insert");
+    atomic<int> running(threadCount);
+    vector<thread> threads;
+    for (int t = 0; t < threadCount; t++)
+    {
+        threads.push_back(thread([&running, t, perThread]() {
+            BST tree(true);
+            for (int i = 0; i < perThread; i++)
+            {
+                tree.insert(i * 7919 % perThread + t);
+            }
+            running--;
+        }));
+    }
+    while (running.load() > 0)
+    {
+        profiledCount("BST::insert");
+    }
+    for (int t = 0; t < threadCount; t++)
+    {
+        threads[t].join();
+    }
+    unsigned long long recorded = profiledCount("BST::insert") - before;
+    if (recorded != static_cast<unsigned long long>(threadCount * perThread))
+    {
+        cerr << "  " << recorded << " of " << threadCount * perThread << " inserts recorded\n";
+        return false;
+    }
+    return true;
+}
+#endif
+
+// ==================== Main Function ====================
+
+struct Check
+{
+    const char* name;
+    bool (*run)();
+};
+
+int main()
+{
+    const Check checks[] = {
+        { "BST frozen and unfrozen contains against std::multiset", checkFrozenLookups },
+        { "BST select/rank/countRange and cached maximum", checkOrderStatistics },
+        { "BST buildFrom, then inserts and removes, against std::multiset", checkBuildFrom },
+        { "BST compact between random inserts and removes", checkCompact },
+        { "BST traversal/display/freeze/remove on a 20000-level chain", checkDeepChain },
+        { "BST balanced display against goldens and its width limit", checkBalancedDisplay },
+        { "ConcurrentBST from eight threads, and yielding in its CAS windows", checkConcurrentBST },
+        { "BinaryTree and Heap canvas against goldens and the old renderer", checkTreeCanvas },
+        { "BinaryTree isFull/isComplete/isPerfect", checkBinaryTreeShape },
+        { "BinaryTree linked and implicit layouts hold the same values", checkBinaryTreeLayouts },
+        { "BasicHeap arity 2/3/4/8 and SIMD child selection against a sort", checkDaryHeap },
+        { "MinMaxHeap and min-max Heap mode against std::multiset", checkMinMaxHeap },
+        { "IndexedHeap handles, update/erase and position map", checkIndexedHeap },
+        { "PairingHeap insert/removeRoot/merge against std::multiset", checkPairingHeap },
+        { "ExternalHeap against std::multiset", checkExternalHeap },
+        { "MultiQueue concurrent push/pop, every value out once", checkMultiQueue },
+        { "TopK and --topk against a full sort", checkTopK },
+        { "RBTree session against std::set and the recursive walks", checkRBTree },
+#ifdef TREES_PROFILE
+        { "profile histogram bucket round trip", checkProfileBuckets },
+        { "profile recording from four threads while printing", checkProfileThreads },
+#endif
+    };
+    // The structures print status messages to cout as they go; they are
+    // dropped while a check runs, and the checks report mismatches on cerr.
+    DiscardBuffer discard;
+    int failures = 0;
+    for (size_t i = 0; i < sizeof(checks) / sizeof(checks[0]); i++)
+    {
+        streambuf* saved = cout.rdbuf(&discard);
+        bool passed = checks[i].run();
+        cout.rdbuf(saved);
+        cout << (passed ? "PASS  " : "FAIL  ") << checks[i].name << "\n";
+        cout.flush();
+        failures += passed ? 0 : 1;
+    }
+    return failures == 0 ? 0 : 1;
+}
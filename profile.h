@@ -0,0 +1,357 @@
+/*
+ * profile.h
+ * Optional per-operation latency profiling shared by bstbt.cpp and rbtree.cpp.
+ *
+ * Compiled out unless TREES_PROFILE is defined; TREES_PROFILE_SCOPE(name) is
+ * then empty and costs nothing. With it defined, every scope records its
+ * latency into a histogram owned by the calling thread, so recording never
+ * takes a lock. Histograms are dumped to stderr at exit, and on demand by the
+ * programs' stats commands.
+ *
+ * Setting TREES_TRACE=file also samples one operation in TREES_TRACE_SAMPLE
+ * (default 100) per thread and writes them at exit as Chrome trace-event JSON,
+ * which chrome://tracing and Perfetto can open.
+ */
+
+#ifndef TREES_PROFILE_H
+#define TREES_PROFILE_H
+
+#ifdef TREES_PROFILE
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <vector>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+// HDR-style buckets: values below 16 are exact, and every power of two above
+// that is split into 16 linear sub-buckets, so each bucket is within 1/16 of
+// the values it holds across the whole 64-bit range.
+const int kProfileSubBuckets = 16;
+const int kProfileBuckets = 61 * kProfileSubBuckets;
+const int kMaxProfileSites = 128;
+const size_t kTraceEventsPerThread = 1 << 16;
+
+inline int highestSetBit64(uint64_t value)
+{
+#if defined(_MSC_VER) && defined(_M_X64)
+    unsigned long index;
+    _BitScanReverse64(&index, value);
+    return index;
+#elif defined(_MSC_VER)
+    int index = 0;
+    while (value >>= 1)
+        index++;
+    return index;
+#else
+    return 63 - __builtin_clzll(value);
+#endif
+}
+
+inline int profileBucket(uint64_t nanoseconds)
+{
+    if (nanoseconds < kProfileSubBuckets)
+    {
+        return static_cast<int>(nanoseconds);
+    }
+    int exponent = highestSetBit64(nanoseconds);
+    int sub = static_cast<int>(nanoseconds >> (exponent - 4)) & (kProfileSubBuckets - 1);
+    return (exponent - 3) * kProfileSubBuckets + sub;
+}
+
+// The largest value that falls into bucket.
+inline uint64_t profileBucketLimit(int bucket)
+{
+    if (bucket < kProfileSubBuckets)
+    {
+        return bucket;
+    }
+    int exponent = bucket / kProfileSubBuckets + 3;
+    uint64_t sub = bucket % kProfileSubBuckets;
+    return ((kProfileSubBuckets + sub + 1) << (exponent - 4)) - 1;
+}
+
+struct ProfileHistogram
+{
+    std::atomic<uint64_t> counts[kProfileBuckets];
+
+    ProfileHistogram()
+    {
+        for (int i = 0; i < kProfileBuckets; i++)
+            counts[i].store(0, std::memory_order_relaxed);
+    }
+};
+
+struct TraceEvent
+{
+    int site;
+    uint64_t start;
+    uint64_t duration;
+};
+
+// Everything one thread records. Only the owning thread writes; readers use
+// relaxed loads for the counters and acquire the published event count.
+struct ProfileThread
+{
+    int id;
+    std::atomic<ProfileHistogram*> histograms[kMaxProfileSites];
+    TraceEvent* events;
+    std::atomic<size_t> eventCount;
+    unsigned untilSample;
+    ProfileThread* next;
+
+    ProfileThread(int id) : id(id), events(nullptr), eventCount(0), untilSample(0), next(nullptr)
+    {
+        for (int i = 0; i < kMaxProfileSites; i++)
+            histograms[i].store(nullptr, std::memory_order_relaxed);
+    }
+
+    ~ProfileThread()
+    {
+        for (int i = 0; i < kMaxProfileSites; i++)
+            delete histograms[i].load(std::memory_order_relaxed);
+        delete[] events;
+    }
+};
+
+class Profiler
+{
+private:
+    typedef std::chrono::steady_clock Clock;
+
+    std::mutex registration;
+    const char* siteNames[kMaxProfileSites];
+    std::atomic<int> siteCount;
+    ProfileThread* threads;
+    int threadCount;
+    Clock::time_point epoch;
+    std::string tracePath;
+    unsigned traceInterval;
+
+    Profiler() : siteCount(0), threads(nullptr), threadCount(0), epoch(Clock::now()), traceInterval(0)
+    {
+        const char* path = std::getenv("TREES_TRACE");
+        if (path != nullptr && *path != '\0')
+        {
+            tracePath = path;
+            const char* sample = std::getenv("TREES_TRACE_SAMPLE");
+            long interval = sample != nullptr ? std::atol(sample) : 100;
+            traceInterval = interval > 0 ? static_cast<unsigned>(interval) : 100;
+        }
+    }
+
+    Profiler(const Profiler&);
+    Profiler& operator=(const Profiler&);
+
+    // Threads register once and their records outlive them, so operations
+    // from short-lived workers still show up in the exit dump.
+    ProfileThread& currentThread()
+    {
+        static thread_local ProfileThread* current = nullptr;
+        if (current == nullptr)
+        {
+            std::lock_guard<std::mutex> guard(registration);
+            current = new ProfileThread(threadCount++);
+            current->next = threads;
+            threads = current;
+        }
+        return *current;
+    }
+
+    void writeTrace()
+    {
+        std::ofstream out(tracePath.c_str());
+        out << "{\"traceEvents\": [\n";
+        bool first = true;
+        for (ProfileThread* thread = threads; thread != nullptr; thread = thread->next)
+        {
+            size_t count = thread->eventCount.load(std::memory_order_acquire);
+            for (size_t i = 0; i < count; i++)
+            {
+                const TraceEvent& event = thread->events[i];
+                out << (first ? "" : ",\n") << "  {\"name\": \"" << siteNames[event.site]
+                    << "\", \"ph\": \"X\", \"pid\": 1, \"tid\": " << thread->id << std::fixed << std::setprecision(3)
+                    << ", \"ts\": " << event.start / 1000.0 << ", \"dur\": " << event.duration / 1000.0 << "}";
+                first = false;
+            }
+        }
+        out << "\n]}\n";
+        if (!out)
+        {
+            std::cerr << "Cannot write trace to " << tracePath << "\n";
+        }
+    }
+
+public:
+    static Profiler& instance()
+    {
+        static Profiler profiler;
+        return profiler;
+    }
+
+    ~Profiler()
+    {
+        printStats(std::cerr);
+        if (!tracePath.empty())
+        {
+            writeTrace();
+        }
+        while (threads != nullptr)
+        {
+            ProfileThread* next = threads->next;
+            delete threads;
+            threads = next;
+        }
+    }
+
+    int registerSite(const char* name)
+    {
+        std::lock_guard<std::mutex> guard(registration);
+        int site = siteCount.load(std::memory_order_relaxed);
+        if (site == kMaxProfileSites)
+        {
+            return -1;
+        }
+        siteNames[site] = name;
+        siteCount.store(site + 1, std::memory_order_release);
+        return site;
+    }
+
+    uint64_t now() const
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - epoch).count();
+    }
+
+    void record(int site, uint64_t start, uint64_t duration)
+    {
+        if (site < 0)
+        {
+            return;
+        }
+        ProfileThread& thread = currentThread();
+        ProfileHistogram* histogram = thread.histograms[site].load(std::memory_order_relaxed);
+        if (histogram == nullptr)
+        {
+            histogram = new ProfileHistogram;
+            thread.histograms[site].store(histogram, std::memory_order_release);
+        }
+        std::atomic<uint64_t>& bucket = histogram->counts[profileBucket(duration)];
+        bucket.store(bucket.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        if (traceInterval == 0)
+        {
+            return;
+        }
+        if (thread.untilSample-- != 0)
+        {
+            return;
+        }
+        thread.untilSample = traceInterval - 1;
+        size_t count = thread.eventCount.load(std::memory_order_relaxed);
+        if (count == kTraceEventsPerThread)
+        {
+            return;
+        }
+        if (thread.events == nullptr)
+        {
+            thread.events = new TraceEvent[kTraceEventsPerThread];
+        }
+        TraceEvent event = { site, start, duration };
+        thread.events[count] = event;
+        thread.eventCount.store(count + 1, std::memory_order_release);
+    }
+
+    // Merges every thread's histogram per site; percentiles are the upper
+    // limit of the bucket they fall in.
+    void printStats(std::ostream& out)
+    {
+        std::vector<uint64_t> merged(kProfileBuckets);
+        int sites = siteCount.load(std::memory_order_acquire);
+        std::ios::fmtflags flags = out.flags();
+        out << "\nOperation latency (ns)\n"
+            << std::left << std::setw(28) << "operation" << std::right << std::setw(12) << "count" << std::setw(12)
+            << "p50" << std::setw(12) << "p99" << std::setw(12) << "p999" << std::setw(14) << "max" << "\n";
+        std::lock_guard<std::mutex> guard(registration);
+        for (int site = 0; site < sites; site++)
+        {
+            std::fill(merged.begin(), merged.end(), 0);
+            uint64_t total = 0;
+            for (ProfileThread* thread = threads; thread != nullptr; thread = thread->next)
+            {
+                ProfileHistogram* histogram = thread->histograms[site].load(std::memory_order_acquire);
+                if (histogram == nullptr)
+                    continue;
+                for (int b = 0; b < kProfileBuckets; b++)
+                {
+                    uint64_t count = histogram->counts[b].load(std::memory_order_relaxed);
+                    merged[b] += count;
+                    total += count;
+                }
+            }
+            if (total == 0)
+            {
+                continue;
+            }
+            const double quantiles[] = { 0.5, 0.99, 0.999 };
+            uint64_t limits[3] = { 0, 0, 0 };
+            uint64_t seen = 0;
+            int q = 0;
+            int last = 0;
+            for (int b = 0; b < kProfileBuckets; b++)
+            {
+                if (merged[b] == 0)
+                    continue;
+                seen += merged[b];
+                last = b;
+                while (q < 3 && seen >= quantiles[q] * total)
+                {
+                    limits[q++] = profileBucketLimit(b);
+                }
+            }
+            out << std::left << std::setw(28) << siteNames[site] << std::right << std::setw(12) << total
+                << std::setw(12) << limits[0] << std::setw(12) << limits[1] << std::setw(12) << limits[2]
+                << std::setw(14) << profileBucketLimit(last) << "\n";
+        }
+        out.flags(flags);
+    }
+};
+
+// Times the enclosing scope and records it against its site.
+class ProfileScope
+{
+private:
+    int site;
+    uint64_t start;
+
+public:
+    ProfileScope(int site) : site(site), start(Profiler::instance().now()) {}
+
+    ~ProfileScope()
+    {
+        Profiler& profiler = Profiler::instance();
+        profiler.record(site, start, profiler.now() - start);
+    }
+};
+
+#define TREES_PROFILE_CONCAT2(a, b) a##b
+#define TREES_PROFILE_CONCAT(a, b) TREES_PROFILE_CONCAT2(a, b)
+#define TREES_PROFILE_SCOPE(name) \
+    static const int TREES_PROFILE_CONCAT(profileSite, __LINE__) = Profiler::instance().registerSite(name); \
+    ProfileScope TREES_PROFILE_CONCAT(profileScope, __LINE__)(TREES_PROFILE_CONCAT(profileSite, __LINE__))
+
+#else
+
+#define TREES_PROFILE_SCOPE(name)
+
+#endif
+
+#endif
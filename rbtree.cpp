@@ -6,6 +6,10 @@
  *		g++ rbtree.cpp -std=c++11 -o rbtree.exe
  *		./rbtree.exe input.txt
  *
+ * Define TREES_NO_MAIN before including this file to use RBTree elsewhere
+ * (bench.cpp does). Built with -DTREES_PROFILE, the "stats" directive prints
+ * per-operation latency histograms (see profile.h).
+ *
  * Known Bugs and Limitations:
  *		Assumes input file contains one valid, unique string per line.
  *		Does not handle malformed commands beyond printing "Invalid Operation".
@@ -17,6 +21,8 @@
 #include <vector>
 #include <string>
 
+#include "profile.h"
+
 using namespace std;
 
 enum Color { RED, BLACK };
@@ -38,6 +44,13 @@ private:
     int timer;
     vector<Node*> dfsList;
 
+    RBTree(const RBTree&);
+    RBTree& operator=(const RBTree&);
+
+    // check.cpp compares the walks against recursive ones and checks the
+    // red-black invariants.
+    friend struct RBTreeReference;
+
     void leftRotate(Node *x) {
         Node *y = x->right;
         x->right = y->left;
@@ -168,38 +181,33 @@ private:
         x->color = BLACK;
     }
 
-    void dfsHelper(Node *node) {
-        if (node == nil) return;
-        node->discovery_time = timer++;
-        dfsList.push_back(node);
-        dfsHelper(node->left);
-        dfsHelper(node->right);
-        node->finish_time = timer++;
-    }
-
-    Node* queryHelper(Node *node, int d, int f) {
-        if (node == nil) return nullptr;
-        if (node->discovery_time == d && node->finish_time == f) return node;
-        Node *res = queryHelper(node->left, d, f);
-        return res ? res : queryHelper(node->right, d, f);
-    }
-
-    void printRBTHelper(Node *node, int depth) {
-        if (node == nil) return;
-        string indent;
-        for (int i = 0; i < depth; ++i) indent += ". ";
-        cout << indent << node->name
-             << " (" << (node->color == BLACK ? "BLACK" : "RED") << ")" << endl;
-        printRBTHelper(node->left, depth + 1);
-        printRBTHelper(node->right, depth + 1);
+    // Pre-order walk that follows parent links instead of recursing or
+    // keeping a stack. enter(node, depth) runs on the way down and can stop
+    // the walk by returning false; leave(node) runs once both subtrees are done.
+    template <typename Enter, typename Leave>
+    void walk(Enter enter, Leave leave) {
+        Node *node = root;
+        int depth = 0;
+        while (node != nil) {
+            if (!enter(node, depth)) return;
+            if (node->left != nil) { node = node->left; depth++; continue; }
+            if (node->right != nil) { node = node->right; depth++; continue; }
+            while (true) {
+                leave(node);
+                Node *parent = node->parent;
+                if (parent == nil) return;
+                if (node == parent->left && parent->right != nil) { node = parent->right; break; }
+                node = parent;
+                depth--;
+            }
+        }
     }
 
-    Node* searchNode(Node *node, const string &key) {
-        if (node == nil) return nullptr;
-        if (key == node->name) return node;
-        return (key < node->name)
-            ? searchNode(node->left, key)
-            : searchNode(node->right, key);
+    Node* searchNode(const string &key) {
+        Node *node = root;
+        while (node != nil && key != node->name)
+            node = (key < node->name) ? node->left : node->right;
+        return node == nil ? nullptr : node;
     }
 
 public:
@@ -211,7 +219,21 @@ public:
         timer = 1;
     }
 
+    ~RBTree() {
+        vector<Node*> pending;
+        if (root != nil) pending.push_back(root);
+        while (!pending.empty()) {
+            Node *node = pending.back();
+            pending.pop_back();
+            if (node->left != nil) pending.push_back(node->left);
+            if (node->right != nil) pending.push_back(node->right);
+            delete node;
+        }
+        delete nil;
+    }
+
     void insert(const string &key) {
+        TREES_PROFILE_SCOPE("RBTree::insert");
         Node *z = new Node(key, nil);
         Node *y = nil;
         Node *x = root;
@@ -229,13 +251,20 @@ public:
     }
 
     bool insertUnique(const string &key) {
-        if (searchNode(root, key) != nullptr) return false;
+        TREES_PROFILE_SCOPE("RBTree::insertUnique");
+        if (searchNode(key) != nullptr) return false;
         insert(key);
         return true;
     }
 
+    bool contains(const string &key) {
+        TREES_PROFILE_SCOPE("RBTree::contains");
+        return searchNode(key) != nullptr;
+    }
+
     bool deleteNode(const string &key) {
-        Node *z = searchNode(root, key);
+        TREES_PROFILE_SCOPE("RBTree::deleteNode");
+        Node *z = searchNode(key);
         if (!z) return false;
         Node *y = z;
         Color yOrigColor = y->color;
@@ -267,12 +296,19 @@ public:
     }
 
     void dfs() {
+        TREES_PROFILE_SCOPE("RBTree::dfs");
         timer = 1;
         dfsList.clear();
-        dfsHelper(root);
+        walk([this](Node *node, int) {
+                 node->discovery_time = timer++;
+                 dfsList.push_back(node);
+                 return true;
+             },
+             [this](Node *node) { node->finish_time = timer++; });
     }
 
     void printDFS() {
+        TREES_PROFILE_SCOPE("RBTree::printDFS");
         for (auto n : dfsList) {
             cout << n->name << " (" << (n->color == BLACK ? "BLACK" : "RED")
                  << "): d=" << n->discovery_time
@@ -281,17 +317,33 @@ public:
     }
 
     void query(int d, int f) {
-        Node *res = queryHelper(root, d, f);
+        TREES_PROFILE_SCOPE("RBTree::query");
+        Node *res = nullptr;
+        walk([&res, d, f](Node *node, int) {
+                 if (node->discovery_time == d && node->finish_time == f) res = node;
+                 return res == nullptr;
+             },
+             [](Node *) {});
         if (res) cout << "Output: Node " << res->name
                       << " (" << (res->color == BLACK ? "BLACK" : "RED") << ")" << endl;
         else cout << "Invalid Operation" << endl;
     }
 
     void printRBT() {
-        printRBTHelper(root, 0);
+        TREES_PROFILE_SCOPE("RBTree::printRBT");
+        string indent;
+        walk([&indent](Node *node, int depth) {
+                 while ((int)indent.size() < 2 * depth) indent += ". ";
+                 cout.write(indent.data(), 2 * depth);
+                 cout << node->name
+                      << " (" << (node->color == BLACK ? "BLACK" : "RED") << ")" << endl;
+                 return true;
+             },
+             [](Node *) {});
     }
 };
 
+#ifndef TREES_NO_MAIN
 int main(int argc, char *argv[]) {
     if (argc != 2) {
         cerr << "Usage: " << argv[0] << " input.txt\n";
@@ -333,6 +385,10 @@ int main(int argc, char *argv[]) {
             else tree.query(d, f);
         } else if (cmd == "print-rbt") {
             tree.printRBT();
+#ifdef TREES_PROFILE
+        } else if (cmd == "stats") {
+            Profiler::instance().printStats(cout);
+#endif
         } else if (cmd == "quit") {
             break;
         } else {
@@ -340,4 +396,5 @@ int main(int argc, char *argv[]) {
         }
     }
     return 0;
-}
\ No newline at end of file
+}
+#endif